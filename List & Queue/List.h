@@ -2,7 +2,7 @@
 
 #include <cstddef> // size_t
 #include <iterator> // std::bidirectional_iterator_tag
-#include <type_traits> // std::is_same, std::enable_if
+#include <type_traits> // std::is_same, std::enable_if, std::void_t
 
 template <class T>
 class List {
@@ -26,6 +26,7 @@ class List {
         using difference_type   = ptrdiff_t;
         using pointer           = pointer_type;
         using reference         = reference_type;
+        using list_type         = List<value_type>;
     private:
         friend class List<value_type>;
         using Node = typename List<value_type>::Node;
@@ -97,15 +98,12 @@ private:
 
 public:
     List() {
-        std::cout << "Default Constructor called"<< std::endl;
-        
         head.next = &tail;
         tail.prev = &head;
         _size = 0;
     }
 
     List(size_type count, const T& value ) {
-        std::cout << "Insert Constructor with Value called" << std::endl;
         _size = 0;
         Node * traverse = &head;
         for (int i = 0; i< count; i++){
@@ -121,7 +119,6 @@ public:
     }
 
     explicit List( size_type count ) {
-        std::cout << "Default Insert Constructor called" <<std::endl;
         _size = 0;
         Node* traverse = &head;
         for (size_type i = 0; i < count; i++){
@@ -139,9 +136,6 @@ public:
     }
 
     List( const List& other ) {
-        std::cout << "Copy constructor called" << std::endl;
-
-        
         Node* traverseThis = &head;
         basic_iterator it = other.begin();
         _size=0;
@@ -165,8 +159,6 @@ public:
     }
 
     List( List&& other ){
-        std::cout << "Move Constructor called" << std::endl;
-
         head.next = other.head.next;
         head.next->prev = &head;
 
@@ -185,8 +177,6 @@ public:
         clear();
     }
     List& operator=( const List& other ) {
-        std::cout << "Copy operator called" << std::endl;
-
         if (this->begin() != other.begin()){
 
             
@@ -209,8 +199,6 @@ public:
         return *this;
     }
     List& operator=( List&& other ) noexcept {
-        std::cout << "Operator Move called" << std::endl;
-
         if (this->begin() == other.begin()){
             return *this;
         }
@@ -275,13 +263,11 @@ public:
     }
 
     void clear() noexcept {
-        Node * traverse = &head;
-        Node * ahead = head.next;
-        while(traverse -> next != &tail){
-            traverse = traverse -> next;
+        Node * traverse = head.next;
+        while(traverse != &tail){
+            Node * ahead = traverse -> next;
             delete traverse;
             traverse = ahead;
-            ahead = ahead -> next;
             _size--;
         }
         head.next = &tail;
@@ -317,8 +303,24 @@ public:
         return iterator(returnThis);
     }
 
+    // Moves the node at it from other to before pos, nothing is copied or allocated
+    void splice( const_iterator pos, List& other, const_iterator it ) noexcept {
+        if (pos == it || pos.node -> prev == it.node) {
+            return;
+        }
+        it.node -> prev -> next = it.node -> next;
+        it.node -> next -> prev = it.node -> prev;
+
+        it.node -> prev = pos.node -> prev;
+        it.node -> next = pos.node;
+        pos.node -> prev -> next = it.node;
+        pos.node -> prev = it.node;
+
+        other._size--;
+        _size++;
+    }
+
     void push_back( const T& value ) {
-        std::cout << "Regular Pushback called" << std::endl;
         Node * endd = new Node(value, tail.prev, &tail);
 
         tail.prev -> next = endd;
@@ -327,7 +329,6 @@ public:
     }
 
     void push_back( T&& value ) {
-        std::cout << "Move Pushback called" << std::endl;
         Node * endd = new Node(std::move(value), tail.prev, &tail);
 
         tail.prev -> next = endd;
@@ -336,8 +337,6 @@ public:
     }
 
     void pop_back() {
-        std::cout << "Popback called" << std::endl;
-
         Node * temp = tail.prev -> prev;
         temp -> next = &tail;
         delete tail.prev;
@@ -375,15 +374,19 @@ public:
       for the const_iterator methods provided above.
     */
     iterator insert( iterator pos, const T & value) { 
-        return insert((const_iterator &) (pos), value);
+        return insert(const_iterator(pos.node), value);
     }
 
     iterator insert( iterator pos, T && value ) {
-        return insert((const_iterator &) (pos), std::move(value));
+        return insert(const_iterator(pos.node), std::move(value));
     }
 
     iterator erase( iterator pos ) {
-        return erase((const_iterator&)(pos));
+        return erase(const_iterator(pos.node));
+    }
+
+    void splice( iterator pos, List& other, iterator it ) noexcept {
+        splice(const_iterator(pos.node), other, const_iterator(it.node));
     }
 };
 
@@ -396,13 +399,23 @@ public:
 */
  
 namespace {
+    // The List an iterator belongs to. Other iterators have none, so comparing them never
+    // instantiates a List of their value type.
+    template<typename Iter, typename = void>
+    struct list_of_iter {};
+
+    template<typename Iter>
+    struct list_of_iter<Iter, std::void_t<typename Iter::list_type>> {
+        using type = typename Iter::list_type;
+    };
+
     template<typename Iter, typename ConstIter, typename T>
     using enable_for_list_iters = typename std::enable_if<
         std::is_same<
-            typename List<typename std::iterator_traits<Iter>::value_type>::iterator, 
+            typename list_of_iter<Iter>::type::iterator, 
             Iter
         >{} && std::is_same<
-            typename List<typename std::iterator_traits<Iter>::value_type>::const_iterator,
+            typename list_of_iter<Iter>::type::const_iterator,
             ConstIter
         >{}, T>::type;
 }
@@ -83,6 +83,16 @@ private:
 
 public:
     PriorityQueue() = default;
+
+    /**
+     * @brief Construct an empty heap ordered by a specific comparator object, for comparators with state.
+     * 
+     * O(1)
+     * 
+     * @param compare copied into comp 
+     */
+    explicit PriorityQueue( const Compare& compare ) : comp{compare} {}
+
     PriorityQueue( const PriorityQueue& other ) = default;
     PriorityQueue( PriorityQueue&& other ) = default;
     ~PriorityQueue() = default;
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cstddef>    // size_t
+#include <cstdint>    // uint64_t
+
+#include "primes.h"
+
+/*
+    Bucket-index policies for UnorderedMap: how a hash code becomes a bucket index, and which
+    bucket counts the table may use. A policy is built for one bucket count, and the table
+    rebuilds it whenever the count changes, so any setup cost is paid once per rehash.
+
+    PrimeModulo     hash % prime, same buckets as plain %, but the division is replaced by a
+                    multiply with a magic number precomputed for the prime (libdivide style).
+    FastRange       Lemire's multiply-shift: the high 64 bits of hash * bucket_count. Any bucket
+                    count works. It reads the high bits of the hash, so the hash goes through a
+                    multiplicative mix first, or hashes that leave those bits zero (identity
+                    hashes of small integers, the polynomial hash mod 2^42) would all land in
+                    bucket 0.
+    PowerOfTwoMask  bucket counts are powers of two and the index is the low bits of the hash
+                    after a full 64-bit finalizer, the cheapest reduction but only as good as
+                    the mixer.
+
+    A policy provides round_bucket_count(n), the smallest usable count >= n, a constructor
+    taking such a count, and operator()(hash) returning an index below it.
+*/
+
+namespace bucket_index_detail
+{
+    inline uint64_t mulhi(uint64_t a, uint64_t b)
+    {
+        return static_cast<uint64_t>((static_cast<unsigned __int128>(a) * b) >> 64);
+    }
+
+    inline int floor_log2(uint64_t n)
+    {
+        return 63 - __builtin_clzll(n);
+    }
+}
+
+class PrimeModulo {
+    uint64_t _divisor;
+    uint64_t _magic;    // 0 when the divisor is a power of two and a shift is enough
+    int _shift;
+    bool _add;          // The magic number needs 65 bits, its top bit is added back in divide()
+
+    // hash / _divisor
+    uint64_t _divide(uint64_t n) const
+    {
+        if (!_magic)
+            {return n >> _shift;}
+
+        uint64_t q = bucket_index_detail::mulhi(_magic, n);
+        if (_add)
+            {return (((n - q) >> 1) + q) >> _shift;}
+        return q >> _shift;
+    }
+
+public:
+    static size_t round_bucket_count(size_t count) {return next_greater_prime(count);}
+
+    explicit PrimeModulo(size_t bucket_count = 1)
+    {
+        _divisor = bucket_count;
+        _shift = bucket_index_detail::floor_log2(_divisor);
+        _add = false;
+
+        if ((_divisor & (_divisor - 1)) == 0)
+        {
+            _magic = 0;
+            return;
+        }
+
+        // m = floor(2^(64 + shift) / d), then round up, keeping one more bit if the error is too big
+        unsigned __int128 numerator = static_cast<unsigned __int128>(1) << (64 + _shift);
+        uint64_t magic = static_cast<uint64_t>(numerator / _divisor);
+        uint64_t remainder = static_cast<uint64_t>(numerator % _divisor);
+
+        if (_divisor - remainder >= (uint64_t(1) << _shift))
+        {
+            uint64_t twice_remainder = remainder + remainder;
+            magic += magic;
+            if (twice_remainder >= _divisor || twice_remainder < remainder)
+                {magic += 1;}
+            _add = true;
+        }
+        _magic = magic + 1;
+    }
+
+    size_t operator()(size_t hash) const {return hash - _divide(hash) * _divisor;}
+};
+
+class FastRange {
+    uint64_t _bucket_count;
+
+public:
+    static size_t round_bucket_count(size_t count) {return count ? count : 1;}
+
+    explicit FastRange(size_t bucket_count = 1) : _bucket_count{bucket_count} { }
+
+    size_t operator()(size_t hash) const
+    {
+        return bucket_index_detail::mulhi(static_cast<uint64_t>(hash) * 0x9E3779B97F4A7C15ull, _bucket_count);
+    }
+};
+
+class PowerOfTwoMask {
+    uint64_t _mask;
+
+public:
+    static size_t round_bucket_count(size_t count)
+    {
+        return count <= 1 ? 1 : size_t(2) << bucket_index_detail::floor_log2(count - 1);
+    }
+
+    explicit PowerOfTwoMask(size_t bucket_count = 1) : _mask{bucket_count - 1} { }
+
+    // MurmurHash3's fmix64, every input bit reaches every low output bit
+    size_t operator()(size_t hash) const
+    {
+        uint64_t h = hash;
+        h ^= h >> 33;
+        h *= 0xFF51AFD7ED558CCDull;
+        h ^= h >> 33;
+        h *= 0xC4CEB9FE1A85EC53ull;
+        h ^= h >> 33;
+        return h & _mask;
+    }
+};
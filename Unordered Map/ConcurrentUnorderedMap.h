@@ -0,0 +1,185 @@
+#pragma once
+
+#include <cstddef>      // size_t
+#include <functional>   // std::hash, std::equal_to
+#include <memory>       // std::unique_ptr
+#include <mutex>        // std::unique_lock
+#include <optional>     // std::optional
+#include <shared_mutex> // std::shared_mutex, std::shared_lock
+#include <utility>      // std::pair
+#include <vector>       // std::vector
+
+#include "UnorderedMap.h"
+#include "BucketIndex.h"
+
+/*
+    Thread-safe hash map made of independent UnorderedMap shards. The high bits of a key's
+    hash (through FastRange) pick its shard, so the bucket index inside the shard, which comes
+    from the hash modulo a prime, stays independent of the shard choice. Every shard has its
+    own reader/writer lock and sits on its own cache lines, so threads working on different
+    shards share nothing.
+
+    Lookups take the shard's lock shared, updates take it exclusive. UnorderedMap's lookups
+    never write to the map, which is what makes concurrent readers of one shard safe.
+
+    There are no iterators, since they would outlive the lock. Values come out as copies
+    (find), or are read or changed in place by a callback that runs under the lock (visit,
+    compute, upsert). A callback must not call back into the same map.
+*/
+
+constexpr size_t CONCURRENT_MAP_SHARDS = 64;
+constexpr size_t CACHE_LINE_SIZE = 64;
+
+template <typename Key, typename T, typename Hash = std::hash<Key>, typename Pred = std::equal_to<Key>>
+class ConcurrentUnorderedMap {
+public:
+    using key_type = Key;
+    using mapped_type = T;
+    using value_type = std::pair<const Key, T>;
+    using hasher = Hash;
+    using key_equal = Pred;
+    using size_type = size_t;
+
+private:
+    struct alignas(CACHE_LINE_SIZE) Shard {
+        mutable std::shared_mutex lock;
+        UnorderedMap<Key, T, Hash, Pred> map;
+
+        Shard(const Hash & hash, const Pred & equal) : map(0, hash, equal) { }
+    };
+
+    std::vector<std::unique_ptr<Shard>> _shards;
+    FastRange _shard_index;
+    Hash _hash;
+
+    Shard & _shard(const Key & key) const {return *_shards[_shard_index(_hash(key))];}
+
+public:
+    explicit ConcurrentUnorderedMap(size_type shard_count = CONCURRENT_MAP_SHARDS, const Hash & hash = Hash { },
+                                    const key_equal & equal = key_equal { })
+        : _shard_index(shard_count ? shard_count : 1), _hash(hash)
+    {
+        for (size_type i = 0; i < (shard_count ? shard_count : 1); i++)
+            {_shards.push_back(std::make_unique<Shard>(hash, equal));}
+    }
+
+    ConcurrentUnorderedMap(const ConcurrentUnorderedMap &) = delete;
+    ConcurrentUnorderedMap & operator=(const ConcurrentUnorderedMap &) = delete;
+
+    size_type shard_count() const noexcept {return _shards.size();}
+
+    // Copy of the value of key, or nothing if it is absent
+    std::optional<T> find(const Key & key) const
+    {
+        Shard & shard = _shard(key);
+        std::shared_lock<std::shared_mutex> lock(shard.lock);
+
+        auto it = shard.map.find(key);
+        if (it == shard.map.end())
+            {return std::nullopt;}
+        return it -> second;
+    }
+
+    bool contains(const Key & key) const
+    {
+        Shard & shard = _shard(key);
+        std::shared_lock<std::shared_mutex> lock(shard.lock);
+        return shard.map.contains(key);
+    }
+
+    // Call f(const T &) on the value of key under the shared lock, false if key is absent
+    template <typename F>
+    bool visit(const Key & key, F && f) const
+    {
+        Shard & shard = _shard(key);
+        std::shared_lock<std::shared_mutex> lock(shard.lock);
+
+        auto it = shard.map.find(key);
+        if (it == shard.map.end())
+            {return false;}
+        f(static_cast<const T &>(it -> second));
+        return true;
+    }
+
+    // Insert key if it is absent, true if it was inserted
+    bool insert(const value_type & value)
+    {
+        Shard & shard = _shard(value.first);
+        std::unique_lock<std::shared_mutex> lock(shard.lock);
+        return shard.map.insert(value).second;
+    }
+
+    // Set the value of key whether it is there or not, true if it was inserted
+    template <typename M>
+    bool insert_or_assign(const Key & key, M && obj)
+    {
+        Shard & shard = _shard(key);
+        std::unique_lock<std::shared_mutex> lock(shard.lock);
+        return shard.map.insert_or_assign(key, std::forward<M>(obj)).second;
+    }
+
+    // Call f(T &) on the value of key under the exclusive lock, so the read-modify-write is atomic.
+    // False, without calling f, if key is absent.
+    template <typename F>
+    bool compute(const Key & key, F && f)
+    {
+        Shard & shard = _shard(key);
+        std::unique_lock<std::shared_mutex> lock(shard.lock);
+
+        auto it = shard.map.find(key);
+        if (it == shard.map.end())
+            {return false;}
+        f(it -> second);
+        return true;
+    }
+
+    // If key is absent insert it with T(args...), otherwise call f(T &) on its value, atomically.
+    // True if it was inserted.
+    template <typename F, typename... Args>
+    bool upsert(const Key & key, F && f, Args &&... args)
+    {
+        Shard & shard = _shard(key);
+        std::unique_lock<std::shared_mutex> lock(shard.lock);
+
+        auto [it, inserted] = shard.map.try_emplace(key, std::forward<Args>(args)...);
+        if (!inserted)
+            {f(it -> second);}
+        return inserted;
+    }
+
+    size_type erase(const Key & key)
+    {
+        Shard & shard = _shard(key);
+        std::unique_lock<std::shared_mutex> lock(shard.lock);
+        return shard.map.erase(key);
+    }
+
+    // Holds every shard's lock at once, so the count is the size at one instant even with
+    // concurrent writers. Writers lock a single shard, and the shards are always locked in
+    // the same order, so this cannot deadlock.
+    size_type size() const
+    {
+        std::vector<std::shared_lock<std::shared_mutex>> locks;
+        locks.reserve(_shards.size());
+
+        size_type size = 0;
+        for (const std::unique_ptr<Shard> & shard : _shards)
+        {
+            locks.emplace_back(shard -> lock);
+            size += shard -> map.size();
+        }
+        return size;
+    }
+
+    bool empty() const {return size() == 0;}
+
+    // Every shard is emptied under its own lock, other threads may insert into shards already cleared
+    void clear()
+    {
+        for (std::unique_ptr<Shard> & shard : _shards)
+        {
+            std::unique_lock<std::shared_mutex> lock(shard -> lock);
+            shard -> map.clear();
+        }
+    }
+};
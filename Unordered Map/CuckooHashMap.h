@@ -0,0 +1,567 @@
+#pragma once
+
+#include <algorithm>  // std::swap
+#include <cstddef>    // size_t
+#include <cstdint>    // uint8_t, uint32_t, uint64_t
+#include <cstring>    // std::memset, std::memcpy
+#include <functional> // std::hash
+#include <iterator>   // std::forward_iterator_tag
+#include <memory>     // std::allocator
+#include <new>        // placement new
+#include <stdexcept>  // std::length_error
+#include <utility>    // std::pair
+#include <vector>     // std::vector
+
+/*
+    Bucketized cuckoo hash map: every key has exactly two candidate buckets of CUCKOO_SLOTS
+    slots, one from each hash function, and is always in one of them. A lookup therefore
+    checks at most 2 * CUCKOO_SLOTS slots whatever the load, and only calls Pred on slots whose
+    one-byte tag matches, so the worst case is as good as the average.
+
+    Inserting into two full buckets makes room by breadth-first search: starting from both
+    candidate buckets, follow each occupant to its other bucket until a bucket with a free slot
+    turns up within CUCKOO_MAX_DEPTH moves, then shift the occupants along that path one step
+    each. When no such path exists the table doubles and every entry is placed again.
+
+    For std::string keys the natural hashes are fnv1a_hash and a seeded polynomial_rolling_hash
+    from hash_functions.h. Any insert can move entries, so iterators are only stable until the
+    next insert.
+
+    Keys whose two hashes are both equal share both buckets at every table size, so at most
+    2 * CUCKOO_SLOTS of them fit, or CUCKOO_SLOTS when the two hashes of a key are equal too
+    (Hash1 == Hash2). Inserting one more throws std::length_error rather than growing forever,
+    so degenerate hashes such as the zero and first character ones of hash_selector do not work.
+*/
+
+constexpr size_t CUCKOO_SLOTS = 4;
+constexpr size_t CUCKOO_MAX_DEPTH = 5;          // Longest displacement path tried before growing
+constexpr size_t CUCKOO_MAX_SEARCH = 2048;      // Buckets visited by one breadth-first search
+
+namespace cuckoo_detail
+{
+    // Multiply and fold so weak hashes still spread over a power-of-two table
+    inline uint64_t mix(size_t hash)
+    {
+        uint64_t mixed = static_cast<uint64_t>(hash) * 0x9E3779B97F4A7C15ull;
+        return mixed ^ (mixed >> 32);
+    }
+
+    // Non-zero tag from the top byte of the first hash, 0 marks a free slot
+    inline uint8_t tag(uint64_t mixed)
+    {
+        uint8_t t = static_cast<uint8_t>(mixed >> 56);
+        return t ? t : 1;
+    }
+
+    // Default second hash for keys without a natural second one: std::hash with a different mix
+    template <typename Key>
+    struct second_hash
+    {
+        size_t operator()(const Key & key) const
+        {
+            uint64_t h = std::hash<Key>{}(key);
+            h ^= h >> 33;
+            h *= 0xFF51AFD7ED558CCDull;
+            h ^= h >> 33;
+            return static_cast<size_t>(h);
+        }
+    };
+}
+
+template <typename Key, typename T, typename Hash1 = std::hash<Key>, typename Hash2 = cuckoo_detail::second_hash<Key>,
+          typename Pred = std::equal_to<Key>>
+class CuckooHashMap {
+    public:
+
+    using key_type = Key;
+    using mapped_type = T;
+    using key_equal = Pred;
+    using value_type = std::pair<const key_type, mapped_type>;
+    using reference = value_type &;
+    using const_reference = const value_type &;
+    using pointer = value_type *;
+    using const_pointer = const value_type *;
+    using size_type = size_t;
+    using difference_type = ptrdiff_t;
+
+    private:
+
+    uint8_t * _tags;        // One per slot, 0 for free, CUCKOO_SLOTS consecutive tags per bucket
+    value_type * _slots;    // Raw storage, only slots with a non-zero tag are constructed
+    size_type _bucket_count;    // A power of two
+    size_type _size;
+
+    Hash1 _hash1;
+    Hash2 _hash2;
+    key_equal _equal;
+
+    struct Location
+    {
+        uint64_t first_mixed;
+        size_type first, second;    // The two candidate buckets
+    };
+
+    size_type _bucket_of(uint64_t mixed) const {return static_cast<size_type>(mixed) & (_bucket_count - 1);}
+
+    Location _locate(const Key & key) const
+    {
+        uint64_t first_mixed = cuckoo_detail::mix(_hash1(key));
+        return {first_mixed, _bucket_of(first_mixed), _bucket_of(cuckoo_detail::mix(_hash2(key)))};
+    }
+
+    // The candidate bucket of key that is not bucket
+    size_type _other_bucket(const Key & key, size_type bucket) const
+    {
+        Location location = _locate(key);
+        return location.first == bucket ? location.second : location.first;
+    }
+
+    // Both arrays are allocated before any member changes, so a throw leaves the table as it was
+    void _allocate(size_type bucket_count)
+    {
+        uint8_t * tags = new uint8_t[bucket_count * CUCKOO_SLOTS]();
+        value_type * slots;
+        try
+        {
+            slots = std::allocator<value_type>().allocate(bucket_count * CUCKOO_SLOTS);
+        }
+        catch (...)
+        {
+            delete[] tags;
+            throw;
+        }
+
+        _tags = tags;
+        _slots = slots;
+        _bucket_count = bucket_count;
+    }
+
+    void _destroy_and_deallocate()
+    {
+        for (size_type i = 0; i < _bucket_count * CUCKOO_SLOTS; i++)
+        {
+            if (_tags[i])
+                {_slots[i].~value_type();}
+        }
+        delete[] _tags;
+        std::allocator<value_type>().deallocate(_slots, _bucket_count * CUCKOO_SLOTS);
+    }
+
+    // Slot of key in bucket, or _capacity() when it is not there
+    size_type _find_in_bucket(size_type bucket, uint8_t tag, const Key & key) const
+    {
+        size_type base = bucket * CUCKOO_SLOTS;
+        for (size_type i = base; i < base + CUCKOO_SLOTS; i++)
+        {
+            if (_tags[i] == tag && _equal(_slots[i].first, key))
+                {return i;}
+        }
+        return _capacity();
+    }
+
+    size_type _find_slot(const Key & key) const
+    {
+        uint64_t first_mixed = cuckoo_detail::mix(_hash1(key));
+        uint8_t tag = cuckoo_detail::tag(first_mixed);
+
+        // Only hash a second time when the key is not in its first bucket
+        size_type slot = _find_in_bucket(_bucket_of(first_mixed), tag, key);
+        if (slot != _capacity())
+            {return slot;}
+        return _find_in_bucket(_bucket_of(cuckoo_detail::mix(_hash2(key))), tag, key);
+    }
+
+    size_type _free_slot(size_type bucket) const
+    {
+        size_type base = bucket * CUCKOO_SLOTS;
+        for (size_type i = base; i < base + CUCKOO_SLOTS; i++)
+        {
+            if (!_tags[i])
+                {return i;}
+        }
+        return _capacity();
+    }
+
+    size_type _capacity() const {return _bucket_count * CUCKOO_SLOTS;}
+
+    // Move the entry in slot from into the free slot to
+    void _move_slot(size_type from, size_type to)
+    {
+        new (&_slots[to]) value_type(std::move(_slots[from]));
+        _slots[from].~value_type();
+        _tags[to] = _tags[from];
+        _tags[from] = 0;
+    }
+
+    // One bucket reached by the search, and how: by moving slot parent_slot of the parent entry
+    struct SearchNode
+    {
+        size_type bucket;
+        size_type parent;       // Index into the search queue, or SIZE_MAX for the two roots
+        size_type parent_slot;
+        size_type depth;
+    };
+
+    /*
+        Free a slot in one of the two buckets of location by breadth-first search over
+        displacements. Returns the freed slot, or _capacity() if none was found in range.
+    */
+    size_type _make_room(const Location & location)
+    {
+        std::vector<SearchNode> queue;
+        queue.push_back({location.first, SIZE_MAX, 0, 0});
+        if (location.second != location.first)
+            {queue.push_back({location.second, SIZE_MAX, 0, 0});}
+
+        for (size_type head = 0; head < queue.size(); head++)
+        {
+            SearchNode node = queue[head];
+            size_type free = _free_slot(node.bucket);
+            if (free != _capacity())
+            {
+                // Walk the path back to a root, each entry moves into the slot freed after it
+                size_type index = head;
+                while (queue[index].parent != SIZE_MAX)
+                {
+                    size_type from = queue[index].parent_slot;
+                    _move_slot(from, free);
+                    free = from;
+                    index = queue[index].parent;
+                }
+                return free;
+            }
+
+            if (node.depth == CUCKOO_MAX_DEPTH)
+                {continue;}
+
+            size_type base = node.bucket * CUCKOO_SLOTS;
+            for (size_type slot = base; slot < base + CUCKOO_SLOTS && queue.size() < CUCKOO_MAX_SEARCH; slot++)
+            {
+                size_type next = _other_bucket(_slots[slot].first, node.bucket);
+
+                // A bucket already on this path would move an entry twice
+                bool on_path = next == node.bucket;
+                for (size_type index = head; !on_path && queue[index].parent != SIZE_MAX; index = queue[index].parent)
+                    {on_path = queue[queue[index].parent].bucket == next;}
+
+                if (!on_path)
+                    {queue.push_back({next, head, slot, node.depth + 1});}
+            }
+        }
+        return _capacity();
+    }
+
+    // A free slot in one of key's buckets, displacing other entries if needed, or _capacity()
+    size_type _place(const Key & key)
+    {
+        Location location = _locate(key);
+        size_type slot = _free_slot(location.first);
+        if (slot == _capacity())
+            {slot = _free_slot(location.second);}
+        if (slot == _capacity())
+            {slot = _make_room(location);}
+        return slot;
+    }
+
+    // Double the table and place every entry again
+    void _grow()
+    {
+        uint8_t * tags = _tags;
+        value_type * slots = _slots;
+        size_type capacity = _capacity();
+
+        _allocate(_bucket_count * 2);
+        _size = 0;
+        _absorb(tags, slots, capacity);
+    }
+
+    // Move every entry of another slot array into this table, doubling it again whenever one
+    // does not fit, then free that array. Tags only depend on the first hash so they carry over.
+    void _absorb(uint8_t * tags, value_type * slots, size_type capacity)
+    {
+        for (size_type i = 0; i < capacity; i++)
+        {
+            if (!tags[i])
+                {continue;}
+
+            size_type slot = _place(slots[i].first);
+            while (slot == _capacity())
+            {
+                _grow();
+                slot = _place(slots[i].first);
+            }
+
+            new (&_slots[slot]) value_type(std::move(slots[i]));
+            slots[i].~value_type();
+            _tags[slot] = tags[i];
+            _size++;
+        }
+
+        delete[] tags;
+        std::allocator<value_type>().deallocate(slots, capacity);
+    }
+
+    // True when the entries sharing both of key's hashes already fill every slot those hashes
+    // can ever reach, so no table size has room for key
+    bool _never_fits(const Key & key) const
+    {
+        uint64_t first = cuckoo_detail::mix(_hash1(key));
+        uint64_t second = cuckoo_detail::mix(_hash2(key));
+        size_type room = first == second ? CUCKOO_SLOTS : 2 * CUCKOO_SLOTS;
+
+        size_type buckets[] = {_bucket_of(first), _bucket_of(second)};
+        size_type sharing = 0;
+        for (size_type b = 0; b < (buckets[0] == buckets[1] ? 1 : 2); b++)
+        {
+            for (size_type i = buckets[b] * CUCKOO_SLOTS; i < (buckets[b] + 1) * CUCKOO_SLOTS; i++)
+            {
+                if (!_tags[i])
+                    {continue;}
+                uint64_t other_first = cuckoo_detail::mix(_hash1(_slots[i].first));
+                uint64_t other_second = cuckoo_detail::mix(_hash2(_slots[i].first));
+                if ((other_first == first && other_second == second) || (other_first == second && other_second == first))
+                    {sharing++;}
+            }
+        }
+        return sharing >= room;
+    }
+
+    // Construct a new entry for a key that is not in the map, growing until it fits. Every entry
+    // admitted here fits at some table size, which is what lets _absorb grow without a bound.
+    template <typename... Args>
+    size_type _emplace_new(const Key & key, Args &&... args)
+    {
+        size_type slot = _place(key);
+        while (slot == _capacity())
+        {
+            if (_never_fits(key))
+                {throw std::length_error("CuckooHashMap: too many keys with the same two hashes, no table size can hold them");}
+            _grow();
+            slot = _place(key);
+        }
+
+        new (&_slots[slot]) value_type(std::forward<Args>(args)...);
+        _tags[slot] = cuckoo_detail::tag(cuckoo_detail::mix(_hash1(key)));
+        _size++;
+        return slot;
+    }
+
+    static size_type _buckets_for(size_type count)
+    {
+        size_type bucket_count = 1;
+        while (bucket_count * CUCKOO_SLOTS < count)
+            {bucket_count *= 2;}
+        return bucket_count;
+    }
+
+    public:
+
+    template <typename map_pointer, typename _value_type>
+    class basic_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = _value_type;
+        using difference_type = ptrdiff_t;
+        using pointer = value_type *;
+        using reference = value_type &;
+
+    private:
+        friend class CuckooHashMap;
+
+        map_pointer _map;
+        size_type _index;
+
+        basic_iterator(map_pointer map, size_type index) noexcept : _map{map}, _index{index} {}
+
+        void _skip_free()
+        {
+            while (_index < _map -> _capacity() && !_map -> _tags[_index])
+                {_index++;}
+        }
+
+    public:
+        basic_iterator() : _map{nullptr}, _index{0} {}
+
+        reference operator*() const {return _map -> _slots[_index];}
+        pointer operator->() const {return &(_map -> _slots[_index]);}
+
+        basic_iterator &operator++()
+        {
+            _index++;
+            _skip_free();
+            return *this;
+        }
+
+        basic_iterator operator++(int)
+        {
+            basic_iterator temp = *this;
+            ++(*this);
+            return temp;
+        }
+
+        bool operator==(const basic_iterator &other) const noexcept {return _index == other._index;}
+        bool operator!=(const basic_iterator &other) const noexcept {return _index != other._index;}
+    };
+
+    using iterator = basic_iterator<CuckooHashMap *, value_type>;
+    using const_iterator = basic_iterator<const CuckooHashMap *, const value_type>;
+
+    explicit CuckooHashMap(size_type bucket_count = 0, const Hash1 & hash1 = Hash1 { }, const Hash2 & hash2 = Hash2 { },
+                           const key_equal & equal = key_equal { })
+        : _size{0}, _hash1{hash1}, _hash2{hash2}, _equal{equal}
+    {
+        _allocate(_buckets_for(bucket_count));
+    }
+
+    ~CuckooHashMap() {_destroy_and_deallocate();}
+
+    // Same table size and hashes, so every entry can be copied into the same slot
+    CuckooHashMap(const CuckooHashMap & other)
+        : _size{other._size}, _hash1{other._hash1}, _hash2{other._hash2}, _equal{other._equal}
+    {
+        _allocate(other._bucket_count);
+        for (size_type i = 0; i < _capacity(); i++)
+        {
+            if (other._tags[i])
+                {new (&_slots[i]) value_type(other._slots[i]);}
+        }
+        std::memcpy(_tags, other._tags, _capacity());
+    }
+
+    // Takes other's table and leaves it empty with a single bucket
+    CuckooHashMap(CuckooHashMap && other)
+        : _size{0}, _hash1{other._hash1}, _hash2{other._hash2}, _equal{other._equal}
+    {
+        _allocate(1);
+        swap(other);
+    }
+
+    CuckooHashMap & operator=(const CuckooHashMap & other)
+    {
+        if (this != &other)
+        {
+            CuckooHashMap copy(other);
+            swap(copy);
+        }
+        return *this;
+    }
+
+    CuckooHashMap & operator=(CuckooHashMap && other)
+    {
+        if (this != &other)
+        {
+            CuckooHashMap taken(std::move(other));
+            swap(taken);
+        }
+        return *this;
+    }
+
+    void swap(CuckooHashMap & other) noexcept
+    {
+        std::swap(_tags, other._tags);
+        std::swap(_slots, other._slots);
+        std::swap(_bucket_count, other._bucket_count);
+        std::swap(_size, other._size);
+        std::swap(_hash1, other._hash1);
+        std::swap(_hash2, other._hash2);
+        std::swap(_equal, other._equal);
+    }
+
+    void clear() noexcept
+    {
+        for (size_type i = 0; i < _capacity(); i++)
+        {
+            if (_tags[i])
+            {
+                _slots[i].~value_type();
+                _tags[i] = 0;
+            }
+        }
+        _size = 0;
+    }
+
+    size_type size() const noexcept {return _size;}
+
+    bool empty() const noexcept {return _size == 0;}
+
+    size_type bucket_count() const noexcept {return _bucket_count;}
+
+    // Entries per slot, cuckoo tables usually fill to about 0.95 before a displacement fails
+    float load_factor() const {return float(_size) / _capacity();}
+
+    iterator begin()
+    {
+        iterator it(this, 0);
+        it._skip_free();
+        return it;
+    }
+    iterator end() {return iterator(this, _capacity());}
+
+    const_iterator cbegin() const
+    {
+        const_iterator it(this, 0);
+        it._skip_free();
+        return it;
+    }
+    const_iterator cend() const {return const_iterator(this, _capacity());}
+
+    // Make room for count entries in total, the table may still grow earlier if displacement fails
+    void reserve(size_type count)
+    {
+        while (_bucket_count < _buckets_for(count))
+            {_grow();}
+    }
+
+    std::pair<iterator, bool> insert(value_type && value)
+    {
+        size_type slot = _find_slot(value.first);
+        if (slot != _capacity())
+            {return {iterator(this, slot), false};}
+        return {iterator(this, _emplace_new(value.first, std::move(value))), true};
+    }
+
+    std::pair<iterator, bool> insert(const value_type & value)
+    {
+        size_type slot = _find_slot(value.first);
+        if (slot != _capacity())
+            {return {iterator(this, slot), false};}
+        return {iterator(this, _emplace_new(value.first, value)), true};
+    }
+
+    iterator find(const Key & key) {return iterator(this, _find_slot(key));}
+
+    const_iterator find(const Key & key) const {return const_iterator(this, _find_slot(key));}
+
+    T& operator[](const Key & key)
+    {
+        size_type slot = _find_slot(key);
+        if (slot == _capacity())
+            {slot = _emplace_new(key, key, T{});}
+        return _slots[slot].second;
+    }
+
+    // Erasing never moves other entries, so the returned iterator continues the traversal
+    iterator erase(iterator pos)
+    {
+        if (pos == end())
+            {return end();}
+
+        _slots[pos._index].~value_type();
+        _tags[pos._index] = 0;
+        _size--;
+        ++pos;
+        return pos;
+    }
+
+    size_type erase(const Key & key)
+    {
+        size_type slot = _find_slot(key);
+        if (slot == _capacity())
+            {return 0;}
+
+        _slots[slot].~value_type();
+        _tags[slot] = 0;
+        _size--;
+        return 1;
+    }
+};
@@ -0,0 +1,507 @@
+#pragma once
+
+#include <algorithm>  // std::max, std::swap
+#include <cstddef>    // size_t
+#include <cstdint>    // int8_t, uint16_t, uint64_t
+#include <cstring>    // std::memset, std::memcpy
+#include <functional> // std::hash
+#include <iterator>   // std::forward_iterator_tag
+#include <memory>     // std::allocator
+#include <new>        // placement new
+#include <utility>    // std::pair
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/*
+    Open addressing hash map in the style of Abseil's Swiss table.
+
+    Entries live inline in one array of slots, next to a parallel array of one control byte per
+    slot: EMPTY, DELETED (a tombstone) or FULL, in which case the byte holds 7 bits of the hash.
+    Slots are grouped 16 at a time and a lookup loads the 16 control bytes of a group, compares
+    them all against the 7-bit hash with one SSE2 instruction and only calls Pred on the (few)
+    slots that match. Groups are probed quadratically and a lookup stops at the first group
+    with an EMPTY byte, so misses are as cheap as hits.
+
+    The table grows (doubling, always a power of two) once full slots plus tombstones would go
+    above 7/8 of the capacity. If most of that is tombstones it is rebuilt at the same size.
+
+    Same interface as UnorderedMap, except there are no buckets to iterate (begin(n), bucket_size)
+    and max_load_factor is fixed. Any insert may move every entry, so iterators and references
+    are only stable until the next insert.
+*/
+
+constexpr size_t FLAT_GROUP_SIZE = 16;
+
+namespace flat_hash_detail
+{
+    constexpr int8_t EMPTY = -128;      // 0b10000000
+    constexpr int8_t DELETED = -2;      // 0b11111110, FULL bytes are 0b0xxxxxxx
+
+    // Bit i is set where byte i of the group satisfies the condition
+    struct Group
+    {
+#if defined(__SSE2__)
+        __m128i ctrl;
+
+        explicit Group(const int8_t * pos) : ctrl{_mm_loadu_si128(reinterpret_cast<const __m128i *>(pos))} {}
+
+        uint16_t match(int8_t h2) const
+            {return static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(h2))));}
+
+        uint16_t match_empty() const
+            {return static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(EMPTY))));}
+
+        // EMPTY and DELETED are the only bytes with the sign bit set
+        uint16_t match_empty_or_deleted() const
+            {return static_cast<uint16_t>(_mm_movemask_epi8(ctrl));}
+#else
+        const int8_t * ctrl;
+
+        explicit Group(const int8_t * pos) : ctrl{pos} {}
+
+        template <typename Condition>
+        uint16_t _mask(Condition condition) const
+        {
+            uint16_t mask = 0;
+            for (size_t i = 0; i < FLAT_GROUP_SIZE; i++)
+                {mask |= static_cast<uint16_t>(condition(ctrl[i])) << i;}
+            return mask;
+        }
+
+        uint16_t match(int8_t h2) const {return _mask([h2](int8_t c) {return c == h2;});}
+        uint16_t match_empty() const {return _mask([](int8_t c) {return c == EMPTY;});}
+        uint16_t match_empty_or_deleted() const {return _mask([](int8_t c) {return c < 0;});}
+#endif
+    };
+
+    // Scramble a possibly weak hash (identity, first character) so both parts below are usable
+    inline size_t mix(size_t hash)
+    {
+        uint64_t mixed = static_cast<uint64_t>(hash) * 0x9E3779B97F4A7C15ull;
+        return static_cast<size_t>(mixed ^ (mixed >> 32));
+    }
+
+    inline size_t h1(size_t mixed) {return mixed >> 7;}                          // Picks the first group
+    inline int8_t h2(size_t mixed) {return static_cast<int8_t>(mixed & 0x7F);}   // Stored in the control byte
+}
+
+template <typename Key, typename T, typename Hash = std::hash<Key>, typename Pred = std::equal_to<Key>>
+class FlatHashMap {
+    public:
+
+    using key_type = Key;
+    using mapped_type = T;
+    using hasher = Hash;
+    using key_equal = Pred;
+    using value_type = std::pair<const key_type, mapped_type>;
+    using reference = value_type &;
+    using const_reference = const value_type &;
+    using pointer = value_type *;
+    using const_pointer = const value_type *;
+    using size_type = size_t;
+    using difference_type = ptrdiff_t;
+
+    private:
+
+    int8_t * _ctrl;         // One control byte per slot
+    value_type * _slots;    // Raw storage, only slots whose control byte is FULL are constructed
+    size_type _capacity;    // Number of slots, a power of two and a multiple of FLAT_GROUP_SIZE
+    size_type _size;
+    size_type _deleted;     // Tombstones, they count against the load factor until the next rehash
+
+    Hash _hash;
+    key_equal _equal;
+
+    static size_type _max_filled(size_type capacity) {return capacity - capacity / 8;}
+
+    // Smallest valid capacity that holds count entries under 7/8 load
+    static size_type _capacity_for(size_type count)
+    {
+        size_type capacity = FLAT_GROUP_SIZE;
+        while (_max_filled(capacity) < count)
+            {capacity *= 2;}
+        return capacity;
+    }
+
+    // Visits groups 0, 1, 3, 6, 10, ... away from the first, which covers all of them
+    // when the number of groups is a power of two
+    struct ProbeSequence
+    {
+        size_type mask, offset, index = 0;
+
+        ProbeSequence(size_type hash, size_type groups) : mask{groups - 1}, offset{hash & mask} {}
+
+        size_type group() const {return offset;}
+        void next() {index++; offset = (offset + index) & mask;}
+    };
+
+    ProbeSequence _probe(size_type mixed) const {return ProbeSequence(flat_hash_detail::h1(mixed), _capacity / FLAT_GROUP_SIZE);}
+
+    void _allocate(size_type capacity)
+    {
+        _capacity = capacity;
+        _ctrl = new int8_t[capacity];
+        std::memset(_ctrl, flat_hash_detail::EMPTY, capacity);
+        _slots = std::allocator<value_type>().allocate(capacity);
+    }
+
+    void _destroy_slots()
+    {
+        for (size_type i = 0; i < _capacity; i++)
+        {
+            if (_ctrl[i] >= 0)
+                {_slots[i].~value_type();}
+        }
+    }
+
+    void _deallocate()
+    {
+        delete[] _ctrl;
+        std::allocator<value_type>().deallocate(_slots, _capacity);
+        _ctrl = nullptr;
+        _slots = nullptr;
+    }
+
+    // Slot index holding key, or _capacity when it is not in the map
+    size_type _find_index(const Key & key, size_type mixed) const
+    {
+        using namespace flat_hash_detail;
+
+        int8_t tag = h2(mixed);
+        for (ProbeSequence seq = _probe(mixed); ; seq.next())
+        {
+            size_type base = seq.group() * FLAT_GROUP_SIZE;
+            Group group(_ctrl + base);
+
+            for (uint16_t match = group.match(tag); match; match &= match - 1)
+            {
+                size_type index = base + __builtin_ctz(match);
+                if (_equal(_slots[index].first, key))
+                    {return index;}
+            }
+
+            if (group.match_empty())
+                {return _capacity;}
+        }
+    }
+
+    // First EMPTY or DELETED slot on the probe sequence of a key known not to be in the map
+    size_type _find_free(size_type mixed) const
+    {
+        for (ProbeSequence seq = _probe(mixed); ; seq.next())
+        {
+            size_type base = seq.group() * FLAT_GROUP_SIZE;
+            uint16_t free = flat_hash_detail::Group(_ctrl + base).match_empty_or_deleted();
+            if (free)
+                {return base + __builtin_ctz(free);}
+        }
+    }
+
+    // Move every entry into a fresh table of the given capacity, dropping all tombstones
+    void _resize(size_type capacity)
+    {
+        int8_t * old_ctrl = _ctrl;
+        value_type * old_slots = _slots;
+        size_type old_capacity = _capacity;
+
+        _allocate(capacity);
+        _deleted = 0;
+
+        for (size_type i = 0; i < old_capacity; i++)
+        {
+            if (old_ctrl[i] < 0)
+                {continue;}
+
+            size_type mixed = flat_hash_detail::mix(_hash(old_slots[i].first));
+            size_type index = _find_free(mixed);
+            _ctrl[index] = flat_hash_detail::h2(mixed);
+            new (&_slots[index]) value_type(std::move(old_slots[i]));
+            old_slots[i].~value_type();
+        }
+
+        delete[] old_ctrl;
+        std::allocator<value_type>().deallocate(old_slots, old_capacity);
+    }
+
+    // Make room for one more entry: grow, or just clear out tombstones if they are most of the load
+    void _prepare_insert()
+    {
+        if (_size + _deleted + 1 <= _max_filled(_capacity))
+            {return;}
+
+        if (_size + 1 <= _max_filled(_capacity) / 2)
+            {_resize(_capacity);}
+        else
+            {_resize(_capacity * 2);}
+    }
+
+    // Construct a new entry for a key that is not in the map
+    template <typename... Args>
+    size_type _emplace_new(size_type mixed, Args &&... args)
+    {
+        _prepare_insert();
+
+        size_type index = _find_free(mixed);
+        if (_ctrl[index] == flat_hash_detail::DELETED)
+            {_deleted--;}
+
+        new (&_slots[index]) value_type(std::forward<Args>(args)...);
+        _ctrl[index] = flat_hash_detail::h2(mixed);
+        _size++;
+        return index;
+    }
+
+    void _erase_index(size_type index)
+    {
+        using namespace flat_hash_detail;
+
+        _slots[index].~value_type();
+        _size--;
+
+        // A group that still has an EMPTY byte was never full, so no probe sequence ever went
+        // past it and the slot can go straight back to EMPTY. Otherwise lookups for keys
+        // further along must keep going, so leave a tombstone.
+        size_type base = index / FLAT_GROUP_SIZE * FLAT_GROUP_SIZE;
+        if (Group(_ctrl + base).match_empty())
+        {
+            _ctrl[index] = EMPTY;
+        }
+        else
+        {
+            _ctrl[index] = DELETED;
+            _deleted++;
+        }
+    }
+
+    public:
+
+    template <typename map_pointer, typename _value_type>
+    class basic_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = _value_type;
+        using difference_type = ptrdiff_t;
+        using pointer = value_type *;
+        using reference = value_type &;
+
+    private:
+        friend class FlatHashMap<Key, T, Hash, key_equal>;
+
+        map_pointer _map;
+        size_type _index;   // Slot index, _map->_capacity for end()
+
+        basic_iterator(map_pointer map, size_type index) noexcept : _map{map}, _index{index} {}
+
+        // Move to the first FULL slot at or after _index
+        void _skip_free()
+        {
+            while (_index < _map -> _capacity && _map -> _ctrl[_index] < 0)
+                {_index++;}
+        }
+
+    public:
+        basic_iterator() : _map{nullptr}, _index{0} {}
+
+        reference operator*() const {return _map -> _slots[_index];}
+        pointer operator->() const {return &(_map -> _slots[_index]);}
+
+        basic_iterator &operator++()
+        {
+            _index++;
+            _skip_free();
+            return *this;
+        }
+
+        basic_iterator operator++(int)
+        {
+            basic_iterator temp = *this;
+            ++(*this);
+            return temp;
+        }
+
+        bool operator==(const basic_iterator &other) const noexcept {return _index == other._index;}
+        bool operator!=(const basic_iterator &other) const noexcept {return _index != other._index;}
+    };
+
+    using iterator = basic_iterator<FlatHashMap *, value_type>;
+    using const_iterator = basic_iterator<const FlatHashMap *, const value_type>;
+
+    explicit FlatHashMap(size_type bucket_count = 0, const Hash & hash = Hash { }, const key_equal & equal = key_equal { })
+        : _size{0}, _deleted{0}, _hash{hash}, _equal{equal}
+    {
+        _allocate(_capacity_for(bucket_count));
+    }
+
+    ~FlatHashMap()
+    {
+        _destroy_slots();
+        _deallocate();
+    }
+
+    // Same capacity and hash means every entry goes in the same slot, so copy slot by slot
+    FlatHashMap(const FlatHashMap & other)
+        : _size{other._size}, _deleted{other._deleted}, _hash{other._hash}, _equal{other._equal}
+    {
+        _allocate(other._capacity);
+        for (size_type i = 0; i < _capacity; i++)
+        {
+            if (other._ctrl[i] >= 0)
+                {new (&_slots[i]) value_type(other._slots[i]);}
+        }
+        std::memcpy(_ctrl, other._ctrl, _capacity);
+    }
+
+    // Takes other's table and leaves it an empty one of the smallest size
+    FlatHashMap(FlatHashMap && other)
+        : _size{0}, _deleted{0}, _hash{other._hash}, _equal{other._equal}
+    {
+        _allocate(FLAT_GROUP_SIZE);
+        swap(other);
+    }
+
+    FlatHashMap & operator=(const FlatHashMap & other)
+    {
+        if (this != &other)
+        {
+            FlatHashMap copy(other);
+            swap(copy);
+        }
+        return *this;
+    }
+
+    FlatHashMap & operator=(FlatHashMap && other)
+    {
+        if (this != &other)
+        {
+            FlatHashMap taken(std::move(other));
+            swap(taken);
+        }
+        return *this;
+    }
+
+    void swap(FlatHashMap & other) noexcept
+    {
+        std::swap(_ctrl, other._ctrl);
+        std::swap(_slots, other._slots);
+        std::swap(_capacity, other._capacity);
+        std::swap(_size, other._size);
+        std::swap(_deleted, other._deleted);
+        std::swap(_hash, other._hash);
+        std::swap(_equal, other._equal);
+    }
+
+    // Destroy every entry but keep the capacity
+    void clear() noexcept
+    {
+        _destroy_slots();
+        std::memset(_ctrl, flat_hash_detail::EMPTY, _capacity);
+        _size = 0;
+        _deleted = 0;
+    }
+
+    size_type size() const noexcept {return _size;}
+
+    bool empty() const noexcept {return _size == 0;}
+
+    // Number of slots
+    size_type bucket_count() const noexcept {return _capacity;}
+
+    float load_factor() const {return _capacity ? float(_size) / _capacity : 0.0f;}
+
+    float max_load_factor() const {return 0.875f;}
+
+    // The table always grows at 7/8, this only exists so code written for UnorderedMap compiles
+    void max_load_factor(float) {}
+
+    iterator begin()
+    {
+        iterator it(this, 0);
+        it._skip_free();
+        return it;
+    }
+    iterator end() {return iterator(this, _capacity);}
+
+    const_iterator cbegin() const
+    {
+        const_iterator it(this, 0);
+        it._skip_free();
+        return it;
+    }
+    const_iterator cend() const {return const_iterator(this, _capacity);}
+
+    // Use at least count slots (rounded up to a power of two), but never so few that the
+    // entries go over 7/8. Also clears out every tombstone.
+    void rehash(size_type count)
+    {
+        size_type capacity = FLAT_GROUP_SIZE;
+        while (capacity < count)
+            {capacity *= 2;}
+        capacity = std::max(capacity, _capacity_for(_size));
+
+        if (capacity != _capacity || _deleted)
+            {_resize(capacity);}
+    }
+
+    // Make room for count entries in total without any further rehash
+    void reserve(size_type count)
+    {
+        if (_max_filled(_capacity) < count + _deleted)
+            {_resize(_capacity_for(count));}
+    }
+
+    std::pair<iterator, bool> insert(value_type && value)
+    {
+        size_type mixed = flat_hash_detail::mix(_hash(value.first));
+        size_type index = _find_index(value.first, mixed);
+        if (index != _capacity)
+            {return {iterator(this, index), false};}
+        return {iterator(this, _emplace_new(mixed, std::move(value))), true};
+    }
+
+    std::pair<iterator, bool> insert(const value_type & value)
+    {
+        size_type mixed = flat_hash_detail::mix(_hash(value.first));
+        size_type index = _find_index(value.first, mixed);
+        if (index != _capacity)
+            {return {iterator(this, index), false};}
+        return {iterator(this, _emplace_new(mixed, value)), true};
+    }
+
+    iterator find(const Key & key)
+        {return iterator(this, _find_index(key, flat_hash_detail::mix(_hash(key))));}
+
+    const_iterator find(const Key & key) const
+        {return const_iterator(this, _find_index(key, flat_hash_detail::mix(_hash(key))));}
+
+    T& operator[](const Key & key)
+    {
+        size_type mixed = flat_hash_detail::mix(_hash(key));
+        size_type index = _find_index(key, mixed);
+        if (index == _capacity)
+            {index = _emplace_new(mixed, key, T{});}
+        return _slots[index].second;
+    }
+
+    // Erasing never moves other entries, so the returned iterator continues the traversal
+    iterator erase(iterator pos)
+    {
+        if (pos == end())
+            {return end();}
+
+        _erase_index(pos._index);
+        ++pos;
+        return pos;
+    }
+
+    size_type erase(const Key & key)
+    {
+        size_type index = _find_index(key, flat_hash_detail::mix(_hash(key)));
+        if (index == _capacity)
+            {return 0;}
+
+        _erase_index(index);
+        return 1;
+    }
+};
@@ -0,0 +1,295 @@
+#pragma once
+
+#include <cstddef>      // size_t
+#include <functional>   // std::hash, std::equal_to
+#include <memory>       // std::unique_ptr
+#include <mutex>        // std::mutex, std::lock_guard
+#include <optional>     // std::optional
+#include <utility>      // std::forward
+#include <vector>       // std::vector
+
+#include "UnorderedMap.h"
+#include "BucketIndex.h"
+#include "ConcurrentUnorderedMap.h"   // CACHE_LINE_SIZE
+#include "../List & Queue/List.h"
+
+/*
+    Least recently used cache. A List keeps the entries from most to least recently used, and
+    an UnorderedMap from key to list position finds them. A hit splices the entry's node to the
+    front of the list, a miss that overflows the capacity drops nodes from the back, both
+    without allocating or walking anything.
+
+    Every entry has a charge, 1 unless put() is told otherwise, and the cache holds at most
+    capacity worth of charge. With the default charge the capacity counts entries, passing
+    the size of each value makes it count bytes.
+
+    Key and T must be default constructible, since the list's sentinel nodes hold an entry.
+*/
+
+constexpr size_t LRU_CACHE_SHARDS = 16;
+
+template <typename Key, typename T, typename Hash = std::hash<Key>, typename Pred = std::equal_to<Key>>
+class LRUCache {
+public:
+    using key_type = Key;
+    using mapped_type = T;
+    using hasher = Hash;
+    using key_equal = Pred;
+    using size_type = size_t;
+
+private:
+    struct Entry {
+        Key key;
+        T value;
+        size_type charge;
+    };
+
+    using Position = typename List<Entry>::iterator;
+
+    List<Entry> _order;   // Most recently used first
+    UnorderedMap<Key, Position, Hash, Pred> _index;
+    size_type _capacity;
+    size_type _charge = 0;
+    size_type _hits = 0;
+    size_type _misses = 0;
+    size_type _evictions = 0;
+
+    // Drop least recently used entries until the charge fits
+    void _evict()
+    {
+        while (_charge > _capacity)
+        {
+            Entry & last = _order.back();
+            _charge -= last.charge;
+            _index.erase(last.key);
+            _order.pop_back();
+            _evictions++;
+        }
+    }
+
+public:
+    explicit LRUCache(size_type capacity, const Hash & hash = Hash { }, const key_equal & equal = key_equal { })
+        : _index(0, hash, equal), _capacity(capacity)
+    { }
+
+    LRUCache(const LRUCache &) = delete;
+    LRUCache & operator=(const LRUCache &) = delete;
+
+    // Value of key marked most recently used, or nullptr on a miss. The pointer is valid until
+    // the entry is evicted or erased.
+    T * get(const Key & key)
+    {
+        auto it = _index.find(key);
+        if (it == _index.end())
+        {
+            _misses++;
+            return nullptr;
+        }
+
+        _hits++;
+        _order.splice(_order.begin(), _order, it -> second);
+        return &it -> second -> value;
+    }
+
+    // Value of key without touching the recency order or the counters
+    const T * peek(const Key & key) const
+    {
+        auto it = _index.find(key);
+        return it == _index.cend() ? nullptr : &it -> second -> value;
+    }
+
+    bool contains(const Key & key) const {return _index.contains(key);}
+
+    // Insert or replace the value of key as the most recently used entry, then evict down to
+    // the capacity. An entry charged more than the whole capacity is not kept.
+    template <typename M>
+    void put(const Key & key, M && obj, size_type charge = 1)
+    {
+        if (charge > _capacity)
+        {
+            erase(key);
+            return;
+        }
+
+        auto [it, inserted] = _index.try_emplace(key);
+        if (inserted)
+        {
+            try
+            {
+                _order.push_front(Entry {key, std::forward<M>(obj), charge});
+            }
+            catch (...)
+            {
+                _index.erase(it);
+                throw;
+            }
+            it -> second = _order.begin();
+        }
+        else
+        {
+            Entry & entry = *it -> second;
+            entry.value = std::forward<M>(obj);
+            _charge -= entry.charge;
+            entry.charge = charge;
+            _order.splice(_order.begin(), _order, it -> second);
+        }
+
+        _charge += charge;
+        _evict();
+    }
+
+    size_type erase(const Key & key)
+    {
+        auto it = _index.find(key);
+        if (it == _index.end())
+            {return 0;}
+
+        _charge -= it -> second -> charge;
+        _order.erase(it -> second);
+        _index.erase(it);
+        return 1;
+    }
+
+    void clear()
+    {
+        _index.clear();
+        _order.clear();
+        _charge = 0;
+    }
+
+    // Shrinking the capacity evicts right away
+    void set_capacity(size_type capacity)
+    {
+        _capacity = capacity;
+        _evict();
+    }
+
+    size_type size() const noexcept {return _index.size();}
+    bool empty() const noexcept {return _index.empty();}
+    size_type capacity() const noexcept {return _capacity;}
+    size_type charge() const noexcept {return _charge;}
+
+    size_type hits() const noexcept {return _hits;}
+    size_type misses() const noexcept {return _misses;}
+    size_type evictions() const noexcept {return _evictions;}
+
+    void reset_counters() noexcept {_hits = _misses = _evictions = 0;}
+};
+
+/*
+    LRUCache split into independent shards for concurrent use, picked like the shards of
+    ConcurrentUnorderedMap. A hit reorders its shard's list, so even lookups lock the shard
+    exclusively, and every shard has a mutex of its own on its own cache lines.
+
+    Each shard gets an equal part of the capacity and evicts on its own, so the entries kept are
+    the most recent of each shard rather than exactly the most recent overall.
+*/
+
+template <typename Key, typename T, typename Hash = std::hash<Key>, typename Pred = std::equal_to<Key>>
+class ShardedLRUCache {
+public:
+    using key_type = Key;
+    using mapped_type = T;
+    using hasher = Hash;
+    using key_equal = Pred;
+    using size_type = size_t;
+
+private:
+    struct alignas(CACHE_LINE_SIZE) Shard {
+        mutable std::mutex lock;
+        LRUCache<Key, T, Hash, Pred> cache;
+
+        Shard(size_type capacity, const Hash & hash, const Pred & equal) : cache(capacity, hash, equal) { }
+    };
+
+    std::vector<std::unique_ptr<Shard>> _shards;
+    FastRange _shard_index;
+    Hash _hash;
+
+    Shard & _shard(const Key & key) const {return *_shards[_shard_index(_hash(key))];}
+
+    // Sum of f(const LRUCache &) over the shards, each read under its lock
+    template <typename F>
+    size_type _sum(F && f) const
+    {
+        size_type sum = 0;
+        for (const std::unique_ptr<Shard> & shard : _shards)
+        {
+            std::lock_guard<std::mutex> lock(shard -> lock);
+            sum += f(shard -> cache);
+        }
+        return sum;
+    }
+
+public:
+    explicit ShardedLRUCache(size_type capacity, size_type shard_count = LRU_CACHE_SHARDS, const Hash & hash = Hash { },
+                             const key_equal & equal = key_equal { })
+        : _shard_index(shard_count ? shard_count : 1), _hash(hash)
+    {
+        shard_count = shard_count ? shard_count : 1;
+        for (size_type i = 0; i < shard_count; i++)
+            {_shards.push_back(std::make_unique<Shard>((capacity + shard_count - 1) / shard_count, hash, equal));}
+    }
+
+    ShardedLRUCache(const ShardedLRUCache &) = delete;
+    ShardedLRUCache & operator=(const ShardedLRUCache &) = delete;
+
+    size_type shard_count() const noexcept {return _shards.size();}
+
+    // Copy of the value of key marked most recently used, or nothing on a miss
+    std::optional<T> get(const Key & key)
+    {
+        Shard & shard = _shard(key);
+        std::lock_guard<std::mutex> lock(shard.lock);
+
+        if (T * value = shard.cache.get(key))
+            {return *value;}
+        return std::nullopt;
+    }
+
+    // Call f(T &) on the value of key under the shard's lock, counted like get(). False on a miss.
+    template <typename F>
+    bool visit(const Key & key, F && f)
+    {
+        Shard & shard = _shard(key);
+        std::lock_guard<std::mutex> lock(shard.lock);
+
+        T * value = shard.cache.get(key);
+        if (!value)
+            {return false;}
+        f(*value);
+        return true;
+    }
+
+    template <typename M>
+    void put(const Key & key, M && obj, size_type charge = 1)
+    {
+        Shard & shard = _shard(key);
+        std::lock_guard<std::mutex> lock(shard.lock);
+        shard.cache.put(key, std::forward<M>(obj), charge);
+    }
+
+    size_type erase(const Key & key)
+    {
+        Shard & shard = _shard(key);
+        std::lock_guard<std::mutex> lock(shard.lock);
+        return shard.cache.erase(key);
+    }
+
+    void clear()
+    {
+        for (std::unique_ptr<Shard> & shard : _shards)
+        {
+            std::lock_guard<std::mutex> lock(shard -> lock);
+            shard -> cache.clear();
+        }
+    }
+
+    // Totals over the shards, each shard is read at a different instant
+    size_type size() const {return _sum([](const auto & cache) {return cache.size();});}
+    size_type capacity() const {return _sum([](const auto & cache) {return cache.capacity();});}
+    size_type charge() const {return _sum([](const auto & cache) {return cache.charge();});}
+    size_type hits() const {return _sum([](const auto & cache) {return cache.hits();});}
+    size_type misses() const {return _sum([](const auto & cache) {return cache.misses();});}
+    size_type evictions() const {return _sum([](const auto & cache) {return cache.evictions();});}
+};
@@ -0,0 +1,333 @@
+#pragma once
+
+#include <cstddef>      // size_t
+#include <cstdint>      // uint32_t, uint64_t
+#include <cstdio>       // std::FILE, std::fopen, std::fwrite
+#include <cstring>      // std::memcmp, std::memcpy
+#include <functional>   // std::hash, std::equal_to
+#include <optional>     // std::optional
+#include <stdexcept>    // std::runtime_error
+#include <string>       // std::string
+#include <string_view>  // std::string_view
+#include <type_traits>  // std::is_trivially_copyable, std::enable_if_t
+#include <vector>       // std::vector
+
+#include <fcntl.h>      // open
+#include <sys/mman.h>   // mmap, munmap
+#include <sys/stat.h>   // fstat
+#include <unistd.h>     // close
+
+#include "UnorderedMap.h"
+#include "BucketIndex.h"
+
+/*
+    A frozen, read-only hash table in one file, built once by freeze_map() from an UnorderedMap
+    and opened by MappedUnorderedMap with a single mmap(). Opening reads the header and nothing
+    else, pages of the table are faulted in by the lookups that touch them, and processes
+    opening the same file share those pages through the page cache.
+
+    Layout, every offset counted from the start of the file so it can be mapped anywhere:
+
+        FrozenHeader
+        uint64_t bucket_starts[bucket_count + 1]    records of bucket i are [starts[i], starts[i + 1])
+        Record records[size]                        {cached hash, key, value}, grouped by bucket
+        char blob[blob_size]                        bytes of std::string keys and values
+
+    Trivially copyable keys and values are stored as they are, std::string as an offset and a
+    length into the blob and read back as std::string_view. The bucket of a hash is the same
+    PrimeModulo reduction UnorderedMap uses by default. The hash must give the same codes in
+    the process that reads the file as in the one that wrote it, and the file is only readable
+    on machines with the same byte order and type sizes.
+*/
+
+constexpr char FROZEN_MAGIC[8] = {'U', 'M', 'F', 'R', 'O', 'Z', 'E', 'N'};
+constexpr uint32_t FROZEN_VERSION = 1;
+
+struct FrozenHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t size;
+    uint64_t bucket_count;
+    uint64_t buckets_offset;
+    uint64_t records_offset;
+    uint64_t blob_offset;
+    uint64_t blob_size;
+};
+
+namespace frozen_detail
+{
+    // Sections start on a cache line
+    constexpr uint64_t SECTION_ALIGN = 64;
+
+    inline uint64_t align_section(uint64_t offset) {return (offset + SECTION_ALIGN - 1) / SECTION_ALIGN * SECTION_ALIGN;}
+
+    struct BlobRef {
+        uint64_t offset;
+        uint64_t length;
+    };
+
+    // How a key or value type is stored in a record and read back
+    template <typename T, typename = void>
+    struct Field;
+
+    template <typename T>
+    struct Field<T, std::enable_if_t<std::is_trivially_copyable<T>::value>> {
+        using stored = T;
+        using view = T;
+
+        static stored store(const T & value, std::string &) {return value;}
+        static view load(const stored & value, const char *) {return value;}
+    };
+
+    template <>
+    struct Field<std::string> {
+        using stored = BlobRef;
+        using view = std::string_view;
+
+        static stored store(const std::string & value, std::string & blob)
+        {
+            BlobRef ref {blob.size(), value.size()};
+            blob += value;
+            return ref;
+        }
+
+        static view load(const stored & value, const char * blob) {return std::string_view(blob + value.offset, value.length);}
+    };
+
+    template <typename Key, typename T>
+    struct Record {
+        uint64_t hash;
+        typename Field<Key>::stored key;
+        typename Field<T>::stored value;
+    };
+
+    inline void write_all(std::FILE * file, const void * data, size_t bytes, const std::string & path)
+    {
+        if (bytes && std::fwrite(data, 1, bytes, file) != bytes)
+        {
+            std::fclose(file);
+            throw std::runtime_error("cannot write " + path);
+        }
+    }
+
+    inline void write_padding(std::FILE * file, uint64_t & offset, const std::string & path)
+    {
+        static const char zeros[SECTION_ALIGN] = { };
+        uint64_t aligned = align_section(offset);
+        write_all(file, zeros, aligned - offset, path);
+        offset = aligned;
+    }
+}
+
+// Write map to path in the format above. Hashes are recomputed with map.hash_function(), which
+// is what readers of the file must use too.
+template <typename Key, typename T, typename Hash, typename Pred, typename Allocator, typename BucketIndex>
+void freeze_map(const UnorderedMap<Key, T, Hash, Pred, Allocator, BucketIndex> & map, const std::string & path)
+{
+    using Record = frozen_detail::Record<Key, T>;
+
+    uint64_t bucket_count = PrimeModulo::round_bucket_count(map.size());
+    PrimeModulo range(bucket_count);
+    Hash hash = map.hash_function();
+
+    // Walking the map means a cache miss per node, so it is walked once into a flat array, which
+    // a counting sort by bucket then moves into place
+    std::vector<Record> unsorted(map.size());
+    std::string blob;
+    size_t next = 0;
+    for (auto it = map.cbegin(); it != map.cend(); ++it)
+    {
+        Record & record = unsorted[next++];
+        record.hash = hash(it -> first);
+        record.key = frozen_detail::Field<Key>::store(it -> first, blob);
+        record.value = frozen_detail::Field<T>::store(it -> second, blob);
+    }
+
+    std::vector<uint64_t> starts(bucket_count + 1, 0);
+    for (const Record & record : unsorted)
+        {starts[range(record.hash) + 1]++;}
+    for (uint64_t i = 0; i < bucket_count; i++)
+        {starts[i + 1] += starts[i];}
+
+    std::vector<Record> records(unsorted.size());
+    std::vector<uint64_t> filled(starts.begin(), starts.end() - 1);
+    for (const Record & record : unsorted)
+        {records[filled[range(record.hash)]++] = record;}
+    std::vector<Record>().swap(unsorted);
+
+    FrozenHeader header { };
+    std::memcpy(header.magic, FROZEN_MAGIC, sizeof(FROZEN_MAGIC));
+    header.version = FROZEN_VERSION;
+    header.record_size = sizeof(Record);
+    header.size = records.size();
+    header.bucket_count = bucket_count;
+    header.buckets_offset = frozen_detail::align_section(sizeof(FrozenHeader));
+    header.records_offset = frozen_detail::align_section(header.buckets_offset + starts.size() * sizeof(uint64_t));
+    header.blob_offset = frozen_detail::align_section(header.records_offset + records.size() * sizeof(Record));
+    header.blob_size = blob.size();
+
+    std::FILE * file = std::fopen(path.c_str(), "wb");
+    if (!file)
+        {throw std::runtime_error("cannot create " + path);}
+
+    uint64_t offset = sizeof(FrozenHeader);
+    frozen_detail::write_all(file, &header, sizeof(FrozenHeader), path);
+    frozen_detail::write_padding(file, offset, path);
+    frozen_detail::write_all(file, starts.data(), starts.size() * sizeof(uint64_t), path);
+    offset += starts.size() * sizeof(uint64_t);
+    frozen_detail::write_padding(file, offset, path);
+    frozen_detail::write_all(file, records.data(), records.size() * sizeof(Record), path);
+    offset += records.size() * sizeof(Record);
+    frozen_detail::write_padding(file, offset, path);
+    frozen_detail::write_all(file, blob.data(), blob.size(), path);
+
+    if (std::fclose(file) != 0)
+        {throw std::runtime_error("cannot write " + path);}
+}
+
+/*
+    Read-only view of a file written by freeze_map() for the same Key and T. Lookups hash the
+    key, read two bucket starts and compare the cached hashes of that bucket's records, the
+    key only on a hash match. Values come out as copies, std::string ones as std::string_view
+    into the mapping, valid while the view lives.
+*/
+template <typename Key, typename T, typename Hash = std::hash<Key>, typename Pred = std::equal_to<>>
+class MappedUnorderedMap {
+public:
+    using key_type = Key;
+    using mapped_type = T;
+    using key_view = typename frozen_detail::Field<Key>::view;
+    using mapped_view = typename frozen_detail::Field<T>::view;
+    using size_type = size_t;
+
+private:
+    using Record = frozen_detail::Record<Key, T>;
+
+    const char * _data = nullptr;
+    size_t _bytes = 0;
+    const FrozenHeader * _header = nullptr;
+    const uint64_t * _starts = nullptr;
+    const Record * _records = nullptr;
+    const char * _blob = nullptr;
+    PrimeModulo _range;
+    Hash _hash;
+    Pred _equal;
+
+    void _unmap()
+    {
+        if (_data)
+            {munmap(const_cast<char *>(_data), _bytes);}
+        _data = nullptr;
+    }
+
+    // Every section has to lie inside the file. The bucket starts and blob references inside them
+    // are not checked, that would read the whole file, so only open files freeze_map() wrote.
+    void _validate(const std::string & path)
+    {
+        const FrozenHeader & header = *_header;
+        auto fits = [&](uint64_t offset, uint64_t count, uint64_t size) {
+            return offset <= _bytes && (size == 0 || count <= (_bytes - offset) / size);
+        };
+
+        if (_bytes < sizeof(FrozenHeader) || std::memcmp(header.magic, FROZEN_MAGIC, sizeof(FROZEN_MAGIC)) != 0)
+            {throw std::runtime_error(path + " is not a frozen hash table");}
+        if (header.version != FROZEN_VERSION || header.record_size != sizeof(Record))
+            {throw std::runtime_error(path + " was frozen for other key or value types");}
+        if (header.bucket_count == 0 || header.bucket_count == UINT64_MAX
+            || !fits(header.buckets_offset, header.bucket_count + 1, sizeof(uint64_t))
+            || !fits(header.records_offset, header.size, sizeof(Record))
+            || !fits(header.blob_offset, header.blob_size, 1)
+            || header.buckets_offset % alignof(uint64_t) || header.records_offset % alignof(Record))
+            {throw std::runtime_error(path + " is truncated or corrupt");}
+
+        const uint64_t * starts = reinterpret_cast<const uint64_t *>(_data + header.buckets_offset);
+        if (starts[0] != 0 || starts[header.bucket_count] != header.size)
+            {throw std::runtime_error(path + " is truncated or corrupt");}
+    }
+
+    template <typename K>
+    const Record * _find_record(size_t code, const K & key) const
+    {
+        size_t bucket = _range(code);
+        const Record * record = _records + _starts[bucket];
+        const Record * end = _records + _starts[bucket + 1];
+        for (; record != end; ++record)
+        {
+            if (record -> hash == code && _equal(frozen_detail::Field<Key>::load(record -> key, _blob), key))
+                {return record;}
+        }
+        return nullptr;
+    }
+
+public:
+    explicit MappedUnorderedMap(const std::string & path, const Hash & hash = Hash { }, const Pred & equal = Pred { })
+        : _hash(hash), _equal(equal)
+    {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            {throw std::runtime_error("cannot open " + path);}
+
+        struct stat status;
+        if (fstat(fd, &status) != 0 || status.st_size < static_cast<off_t>(sizeof(FrozenHeader)))
+        {
+            close(fd);
+            throw std::runtime_error(path + " is not a frozen hash table");
+        }
+
+        _bytes = static_cast<size_t>(status.st_size);
+        void * mapping = mmap(nullptr, _bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (mapping == MAP_FAILED)
+            {throw std::runtime_error("cannot map " + path);}
+        _data = static_cast<const char *>(mapping);
+        _header = reinterpret_cast<const FrozenHeader *>(_data);
+
+        try
+        {
+            _validate(path);
+        }
+        catch (...)
+        {
+            _unmap();
+            throw;
+        }
+
+        _starts = reinterpret_cast<const uint64_t *>(_data + _header -> buckets_offset);
+        _records = reinterpret_cast<const Record *>(_data + _header -> records_offset);
+        _blob = _data + _header -> blob_offset;
+        _range = PrimeModulo(_header -> bucket_count);
+    }
+
+    ~MappedUnorderedMap() {_unmap();}
+
+    MappedUnorderedMap(const MappedUnorderedMap &) = delete;
+    MappedUnorderedMap & operator=(const MappedUnorderedMap &) = delete;
+
+    size_type size() const noexcept {return _header -> size;}
+
+    bool empty() const noexcept {return size() == 0;}
+
+    size_type bucket_count() const noexcept {return _header -> bucket_count;}
+
+    // K is Key, or anything Hash and Pred accept, like std::string_view for std::string keys
+    template <typename K>
+    std::optional<mapped_view> find(const K & key) const
+    {
+        const Record * record = _find_record(_hash(key), key);
+        if (!record)
+            {return std::nullopt;}
+        return frozen_detail::Field<T>::load(record -> value, _blob);
+    }
+
+    template <typename K>
+    bool contains(const K & key) const {return _find_record(_hash(key), key) != nullptr;}
+
+    // Call f(key_view, mapped_view) on every entry, in bucket order
+    template <typename F>
+    void for_each(F && f) const
+    {
+        for (const Record * record = _records; record != _records + size(); ++record)
+            {f(frozen_detail::Field<Key>::load(record -> key, _blob), frozen_detail::Field<T>::load(record -> value, _blob));}
+    }
+};
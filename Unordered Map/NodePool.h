@@ -0,0 +1,349 @@
+#pragma once
+
+#include <cstddef>     // size_t
+#include <memory>      // std::shared_ptr, std::unique_ptr, std::allocator
+#include <mutex>       // std::mutex, std::lock_guard
+#include <new>         // operator new, std::align_val_t
+#include <type_traits> // std::true_type, std::false_type
+#include <vector>      // std::vector
+
+/*
+    Fixed-size node allocation for node based containers such as UnorderedMap.
+
+    A NodePool carves nodes of one size out of NODE_POOL_SLAB_SIZE slabs. Fresh nodes come from
+    the current slab in address order, so nodes inserted together sit next to each other, and
+    freed nodes go onto an intrusive free list threaded through the nodes themselves. Nothing
+    goes back to the system until release() or destruction, which free whole slabs at once.
+
+    Two allocators sit on top of it:
+
+    PoolAllocator gives every container its own pools (copies of a container get fresh ones),
+    so UnorderedMap::clear() and the destructor can drop all nodes with release() instead of
+    one deallocate per node. Copies and rebinds of one allocator share its pools, one per node
+    size, and compare equal. Single threaded, like the container it belongs to.
+
+    ThreadCachedPoolAllocator shares one pool per node size across the whole process, fronted
+    by a small free list per thread, so most allocations take no lock. Its nodes can move
+    between containers and threads, so it never releases slabs.
+*/
+
+constexpr size_t NODE_POOL_SLAB_SIZE = size_t(64) << 10;
+constexpr size_t THREAD_CACHE_NODES = 256;      // Free nodes a thread keeps before giving half back
+
+class NodePool {
+    struct FreeNode {
+        FreeNode * next;
+    };
+
+    struct Slab {
+        Slab * next;
+    };
+
+    size_t _node_size;      // Requested size rounded up to the alignment, at least a FreeNode
+    size_t _align;
+    size_t _header;         // Slab header rounded up to the alignment, the first node starts here
+    size_t _slab_bytes;
+
+    Slab * _slabs = nullptr;
+    FreeNode * _free = nullptr;
+    char * _bump = nullptr;         // Next never-used node in the newest slab
+    char * _bump_end = nullptr;
+    size_t _slab_count = 0;
+
+    static size_t _round_up(size_t n, size_t align) {return (n + align - 1) / align * align;}
+
+    void _new_slab()
+    {
+        Slab * slab = static_cast<Slab *>(::operator new(_slab_bytes, std::align_val_t(_align)));
+        slab -> next = _slabs;
+        _slabs = slab;
+        _slab_count++;
+
+        _bump = reinterpret_cast<char *>(slab) + _header;
+        _bump_end = reinterpret_cast<char *>(slab) + _slab_bytes;
+    }
+
+public:
+    NodePool(size_t node_size, size_t align)
+    {
+        _align = align < alignof(FreeNode) ? alignof(FreeNode) : align;
+        _node_size = _round_up(node_size < sizeof(FreeNode) ? sizeof(FreeNode) : node_size, _align);
+        _header = _round_up(sizeof(Slab), _align);
+
+        // Nodes bigger than a slab get a slab each
+        size_t nodes = (NODE_POOL_SLAB_SIZE - _header) / _node_size;
+        _slab_bytes = _header + (nodes ? nodes : 1) * _node_size;
+    }
+
+    ~NodePool() {release();}
+
+    NodePool(const NodePool &) = delete;
+    NodePool & operator=(const NodePool &) = delete;
+
+    void * allocate()
+    {
+        if (_free)
+        {
+            FreeNode * node = _free;
+            _free = node -> next;
+            return node;
+        }
+
+        if (_bump == _bump_end)
+            {_new_slab();}
+
+        void * node = _bump;
+        _bump += _node_size;
+        return node;
+    }
+
+    void deallocate(void * node) noexcept
+    {
+        FreeNode * free = static_cast<FreeNode *>(node);
+        free -> next = _free;
+        _free = free;
+    }
+
+    // Give back a chain of nodes already linked through their first word, first to last
+    void deallocate_chain(void * first, void * last) noexcept
+    {
+        static_cast<FreeNode *>(last) -> next = _free;
+        _free = static_cast<FreeNode *>(first);
+    }
+
+    // Free every slab, every node handed out is gone, whether it was deallocated or not
+    void release() noexcept
+    {
+        while (_slabs)
+        {
+            Slab * next = _slabs -> next;
+            ::operator delete(_slabs, std::align_val_t(_align));
+            _slabs = next;
+        }
+        _free = nullptr;
+        _bump = _bump_end = nullptr;
+        _slab_count = 0;
+    }
+
+    size_t node_size() const noexcept {return _node_size;}
+
+    size_t slab_count() const noexcept {return _slab_count;}
+};
+
+namespace node_pool_detail
+{
+    // The pools of one PoolAllocator and all its copies and rebinds, one per node size
+    class PoolSet {
+        struct Entry {
+            size_t size;
+            size_t align;
+            std::unique_ptr<NodePool> pool;
+        };
+
+        std::vector<Entry> _pools;  // A container rebinds to one or two node types, a scan is enough
+
+    public:
+        NodePool & pool(size_t size, size_t align)
+        {
+            for (Entry & entry : _pools)
+            {
+                if (entry.size == size && entry.align == align)
+                    {return *entry.pool;}
+            }
+            _pools.push_back({size, align, std::make_unique<NodePool>(size, align)});
+            return *_pools.back().pool;
+        }
+    };
+}
+
+template <typename T>
+class PoolAllocator {
+    template <typename U>
+    friend class PoolAllocator;
+
+    std::shared_ptr<node_pool_detail::PoolSet> _pools;  // Shared by copies and rebinds
+    NodePool * _pool = nullptr;     // The pool for sizeof(T) in _pools, looked up on first use
+
+    NodePool & _get_pool()
+    {
+        if (!_pool)
+            {_pool = &_pools -> pool(sizeof(T), alignof(T));}
+        return *_pool;
+    }
+
+public:
+    using value_type = T;
+    using propagate_on_container_copy_assignment = std::false_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    PoolAllocator() : _pools(std::make_shared<node_pool_detail::PoolSet>()) { }
+
+    // A rebound copy shares the pool set and compares equal, its node size gets its own pool in it
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U> & other) noexcept : _pools(other._pools) { }
+
+    // Copying a container must not share its pool, or releasing one would free the other's nodes
+    PoolAllocator select_on_container_copy_construction() const {return PoolAllocator();}
+
+    // The pool only hands out single nodes, arrays go to the global heap
+    T * allocate(size_t n)
+    {
+        if (n != 1)
+            {return std::allocator<T>().allocate(n);}
+        return static_cast<T *>(_get_pool().allocate());
+    }
+
+    void deallocate(T * p, size_t n) noexcept
+    {
+        if (n != 1)
+            {std::allocator<T>().deallocate(p, n);}
+        else
+            {_get_pool().deallocate(p);}
+    }
+
+    // True when no other allocator shares the pools, so release() cannot free someone else's nodes
+    bool releasable() const noexcept {return _pools.use_count() == 1;}
+
+    // Free every node of sizeof(T) at once, the objects in them must already be destroyed
+    void release() noexcept
+    {
+        if (_pool)
+            {_pool -> release();}
+    }
+
+    size_t slab_count() const noexcept {return _pool ? _pool -> slab_count() : 0;}
+
+    template <typename U>
+    bool operator==(const PoolAllocator<U> & other) const noexcept {return _pools == other._pools;}
+
+    template <typename U>
+    bool operator!=(const PoolAllocator<U> & other) const noexcept {return _pools != other._pools;}
+};
+
+namespace node_pool_detail
+{
+    // The process-wide pool for one node size, only touched with its mutex held
+    template <size_t Size, size_t Align>
+    struct SharedPool {
+        std::mutex mutex;
+        NodePool pool {Size, Align};
+
+        // Never destroyed: threads that outlive static destruction may still hold its nodes
+        static SharedPool & instance()
+        {
+            static SharedPool * shared = new SharedPool;
+            return *shared;
+        }
+    };
+
+    template <size_t Size, size_t Align>
+    struct ThreadCache {
+        struct FreeNode {
+            FreeNode * next;
+        };
+
+        FreeNode * head = nullptr;
+        size_t count = 0;
+
+        // Keep the keep most recently freed nodes and hand the rest to the shared pool under one lock
+        void flush(size_t keep) noexcept
+        {
+            if (count <= keep)
+                {return;}
+
+            FreeNode * last = head;
+            for (size_t i = 1; i < keep; i++)
+                {last = last -> next;}
+            FreeNode * first = keep ? last -> next : head;
+            FreeNode * tail = first;
+            while (tail -> next)
+                {tail = tail -> next;}
+
+            if (keep)
+                {last -> next = nullptr;}
+            else
+                {head = nullptr;}
+            count = keep;
+
+            SharedPool<Size, Align> & shared = SharedPool<Size, Align>::instance();
+            std::lock_guard<std::mutex> lock(shared.mutex);
+            shared.pool.deallocate_chain(first, tail);
+        }
+
+        ~ThreadCache() {flush(0);}
+
+        static ThreadCache & local()
+        {
+            static thread_local ThreadCache cache;
+            return cache;
+        }
+    };
+}
+
+template <typename T>
+class ThreadCachedPoolAllocator {
+    static constexpr size_t NODE_SIZE = sizeof(T) < sizeof(void *) ? sizeof(void *) : sizeof(T);
+    static constexpr size_t NODE_ALIGN = alignof(T) < alignof(void *) ? alignof(void *) : alignof(T);
+
+    using Cache = node_pool_detail::ThreadCache<NODE_SIZE, NODE_ALIGN>;
+    using Shared = node_pool_detail::SharedPool<NODE_SIZE, NODE_ALIGN>;
+
+public:
+    using value_type = T;
+    using is_always_equal = std::true_type;
+
+    ThreadCachedPoolAllocator() noexcept = default;
+
+    template <typename U>
+    ThreadCachedPoolAllocator(const ThreadCachedPoolAllocator<U> &) noexcept { }
+
+    T * allocate(size_t n)
+    {
+        if (n != 1)
+            {return std::allocator<T>().allocate(n);}
+
+        Cache & cache = Cache::local();
+        if (cache.head)
+        {
+            typename Cache::FreeNode * node = cache.head;
+            cache.head = node -> next;
+            cache.count--;
+            return reinterpret_cast<T *>(node);
+        }
+
+        // Take half a cache worth under one lock, the rest of the batch serves the next allocations
+        Shared & shared = Shared::instance();
+        std::lock_guard<std::mutex> lock(shared.mutex);
+        for (size_t i = 1; i < THREAD_CACHE_NODES / 2; i++)
+        {
+            typename Cache::FreeNode * node = static_cast<typename Cache::FreeNode *>(shared.pool.allocate());
+            node -> next = cache.head;
+            cache.head = node;
+            cache.count++;
+        }
+        return static_cast<T *>(shared.pool.allocate());
+    }
+
+    void deallocate(T * p, size_t n) noexcept
+    {
+        if (n != 1)
+        {
+            std::allocator<T>().deallocate(p, n);
+            return;
+        }
+
+        Cache & cache = Cache::local();
+        typename Cache::FreeNode * node = reinterpret_cast<typename Cache::FreeNode *>(p);
+        node -> next = cache.head;
+        cache.head = node;
+        if (++cache.count > THREAD_CACHE_NODES)
+            {cache.flush(THREAD_CACHE_NODES / 2);}
+    }
+
+    template <typename U>
+    bool operator==(const ThreadCachedPoolAllocator<U> &) const noexcept {return true;}
+
+    template <typename U>
+    bool operator!=(const ThreadCachedPoolAllocator<U> &) const noexcept {return false;}
+};
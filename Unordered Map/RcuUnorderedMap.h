@@ -0,0 +1,284 @@
+#pragma once
+
+#include <atomic>       // std::atomic, std::atomic_thread_fence, std::atomic_signal_fence
+#include <cstddef>      // size_t
+#include <cstdint>      // uint64_t
+#include <functional>   // std::hash, std::equal_to
+#include <mutex>        // std::mutex, std::lock_guard
+#include <optional>     // std::optional
+#include <utility>      // std::pair, std::move
+#include <vector>       // std::vector
+
+#if defined(__linux__)
+#include <linux/membarrier.h> // MEMBARRIER_CMD_*
+#include <sys/syscall.h>      // SYS_membarrier
+#include <unistd.h>           // syscall
+#endif
+
+#include "UnorderedMap.h"
+#include "ConcurrentUnorderedMap.h"   // CACHE_LINE_SIZE
+
+/*
+    Read-mostly map published RCU style. Readers work on an immutable UnorderedMap reached
+    through one atomic pointer. A writer copies the current version, changes the copy and
+    publishes it with a single pointer store, so readers never wait and never see a half-done
+    update. Writers take a mutex among themselves.
+
+    Old versions are reclaimed by epochs. Every reader thread owns a counter on its own cache
+    line, odd while it is inside a read. When a version is replaced, the counters of the readers
+    inside a read at that moment are remembered, and the version is freed by a later update
+    once each of those counters has moved on, since a reader that entered afterwards can only
+    have seen the new pointer.
+
+    On Linux the writer issues membarrier(), which runs a full memory barrier on every thread
+    of the process. Readers then need no fence of their own: entering and leaving a read are
+    plain stores to their counter, and the lookup costs one acquire load of the version pointer
+    on top of the UnorderedMap lookup. Elsewhere readers fall back to a fence on entry.
+*/
+
+namespace rcu_detail
+{
+    struct alignas(CACHE_LINE_SIZE) ReaderSlot {
+        std::atomic<uint64_t> counter {0};  // Odd while the owning thread is inside a read
+        std::atomic<bool> in_use {false};
+        ReaderSlot * next = nullptr;        // Slots are never freed, only handed to a new thread
+        unsigned depth = 0;                 // Nested reads, only touched by the owning thread
+    };
+
+    // Every reader slot of the process, shared by all maps
+    inline std::atomic<ReaderSlot *> reader_slots {nullptr};
+
+    inline ReaderSlot * acquire_slot()
+    {
+        for (ReaderSlot * slot = reader_slots.load(std::memory_order_acquire); slot; slot = slot -> next)
+        {
+            bool expected = false;
+            if (!slot -> in_use.load(std::memory_order_relaxed) && slot -> in_use.compare_exchange_strong(expected, true))
+                {return slot;}
+        }
+
+        ReaderSlot * slot = new ReaderSlot;
+        slot -> in_use.store(true, std::memory_order_relaxed);
+        slot -> next = reader_slots.load(std::memory_order_relaxed);
+        while (!reader_slots.compare_exchange_weak(slot -> next, slot, std::memory_order_release, std::memory_order_relaxed)) { }
+        return slot;
+    }
+
+    // Owns the calling thread's slot and gives it back when the thread exits
+    struct ThreadSlot {
+        ReaderSlot * slot = acquire_slot();
+
+        ~ThreadSlot() {slot -> in_use.store(false, std::memory_order_release);}
+
+        static ReaderSlot & local()
+        {
+            static thread_local ThreadSlot thread_slot;
+            return *thread_slot.slot;
+        }
+    };
+
+    // Registers for membarrier once, true if the writer can use it instead of reader fences
+    inline bool register_membarrier()
+    {
+#if defined(__linux__) && defined(SYS_membarrier)
+        return syscall(SYS_membarrier, MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0, 0) == 0;
+#else
+        return false;
+#endif
+    }
+
+    inline const bool asymmetric_fences = register_membarrier();
+
+    // The reader half: with membarrier only the compiler must keep the order
+    inline void reader_fence()
+    {
+        if (asymmetric_fences)
+            {std::atomic_signal_fence(std::memory_order_seq_cst);}
+        else
+            {std::atomic_thread_fence(std::memory_order_seq_cst);}
+    }
+
+    // The writer half: a full barrier on every running thread of the process
+    inline void writer_fence()
+    {
+#if defined(__linux__) && defined(SYS_membarrier)
+        if (asymmetric_fences)
+        {
+            syscall(SYS_membarrier, MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0, 0);
+            return;
+        }
+#endif
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+
+    // Marks the calling thread as reading from entry to destruction
+    class ReadGuard {
+        ReaderSlot & _slot;
+
+    public:
+        ReadGuard() : _slot(ThreadSlot::local())
+        {
+            if (_slot.depth++ == 0)
+            {
+                _slot.counter.store(_slot.counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                reader_fence();
+            }
+        }
+
+        ~ReadGuard()
+        {
+            if (--_slot.depth == 0)
+                {_slot.counter.store(_slot.counter.load(std::memory_order_relaxed) + 1, std::memory_order_release);}
+        }
+
+        ReadGuard(const ReadGuard &) = delete;
+        ReadGuard & operator=(const ReadGuard &) = delete;
+    };
+}
+
+template <typename Key, typename T, typename Hash = std::hash<Key>, typename Pred = std::equal_to<Key>>
+class RcuUnorderedMap {
+public:
+    using map_type = UnorderedMap<Key, T, Hash, Pred>;
+    using key_type = Key;
+    using mapped_type = T;
+    using size_type = size_t;
+
+private:
+    // A replaced version and the counters of the readers that were inside a read when it was replaced
+    struct Retired {
+        map_type * map;
+        std::vector<std::pair<rcu_detail::ReaderSlot *, uint64_t>> readers;
+    };
+
+    alignas(CACHE_LINE_SIZE) std::atomic<map_type *> _current;
+    alignas(CACHE_LINE_SIZE) mutable std::mutex _writer;
+    std::vector<Retired> _retired;
+
+    // Free every retired version no reader can still be looking at
+    void _reclaim()
+    {
+        size_t kept = 0;
+        for (size_t i = 0; i < _retired.size(); i++)
+        {
+            bool in_use = false;
+            for (auto & [slot, counter] : _retired[i].readers)
+            {
+                if (slot -> counter.load(std::memory_order_acquire) == counter)
+                {
+                    in_use = true;
+                    break;
+                }
+            }
+
+            // A vector moved onto itself comes out empty, so only move entries that change place
+            if (!in_use)
+                {delete _retired[i].map;}
+            else if (kept++ != i)
+                {_retired[kept - 1] = std::move(_retired[i]);}
+        }
+        _retired.resize(kept);
+    }
+
+    // Make next the current version and retire the old one, _writer must be held
+    void _publish(map_type * next)
+    {
+        map_type * old = _current.load(std::memory_order_relaxed);
+        _current.store(next, std::memory_order_release);
+
+        // Pairs with reader_fence(): a reader this scan sees as outside a read will load the new pointer
+        rcu_detail::writer_fence();
+
+        Retired retired {old, { }};
+        for (rcu_detail::ReaderSlot * slot = rcu_detail::reader_slots.load(std::memory_order_acquire); slot; slot = slot -> next)
+        {
+            uint64_t counter = slot -> counter.load(std::memory_order_acquire);
+            if (counter % 2)
+                {retired.readers.push_back({slot, counter});}
+        }
+        _retired.push_back(std::move(retired));
+        _reclaim();
+    }
+
+public:
+    explicit RcuUnorderedMap(map_type map = map_type(0))
+        : _current(new map_type(std::move(map)))
+    { }
+
+    // No reader may be left when the map is destroyed
+    ~RcuUnorderedMap()
+    {
+        for (Retired & retired : _retired)
+            {delete retired.map;}
+        delete _current.load(std::memory_order_relaxed);
+    }
+
+    RcuUnorderedMap(const RcuUnorderedMap &) = delete;
+    RcuUnorderedMap & operator=(const RcuUnorderedMap &) = delete;
+
+    // Run f(const map_type &) on the current version. It stays valid until f returns, even if
+    // writers replace it meanwhile. f must not keep references or iterators into it.
+    template <typename F>
+    decltype(auto) read(F && f) const
+    {
+        rcu_detail::ReadGuard guard;
+        const map_type & map = *_current.load(std::memory_order_acquire);
+        return f(map);
+    }
+
+    std::optional<T> find(const Key & key) const
+    {
+        return read([&](const map_type & map) -> std::optional<T> {
+            auto it = map.find(key);
+            if (it == map.cend())
+                {return std::nullopt;}
+            return it -> second;
+        });
+    }
+
+    bool contains(const Key & key) const
+        {return read([&](const map_type & map) {return map.contains(key);});}
+
+    size_type size() const
+        {return read([](const map_type & map) {return map.size();});}
+
+    // Copy the current version, run f(map_type &) on the copy and publish it. Costs a full copy,
+    // so batch several changes into one update.
+    template <typename F>
+    void update(F && f)
+    {
+        std::lock_guard<std::mutex> lock(_writer);
+        map_type * next = new map_type(*_current.load(std::memory_order_relaxed));
+        try
+        {
+            f(*next);
+        }
+        catch (...)
+        {
+            delete next;
+            throw;
+        }
+        _publish(next);
+    }
+
+    // Replace the whole content with a map built elsewhere, no copy
+    void store(map_type map)
+    {
+        std::lock_guard<std::mutex> lock(_writer);
+        _publish(new map_type(std::move(map)));
+    }
+
+    template <typename M>
+    void insert_or_assign(const Key & key, M && obj)
+        {update([&](map_type & map) {map.insert_or_assign(key, std::forward<M>(obj));});}
+
+    void erase(const Key & key)
+        {update([&](map_type & map) {map.erase(key);});}
+
+    // Versions replaced but not freed yet, because a reader may still be in them
+    size_type retired() const
+    {
+        std::lock_guard<std::mutex> lock(_writer);
+        return _retired.size();
+    }
+};
@@ -1,14 +1,165 @@
+#pragma once
+
+#include <algorithm>  // std::max
+#include <atomic>     // std::atomic
+#include <cmath>      // std::ceil
 #include <cstddef>    // size_t
+#include <cstdint>    // uintptr_t
+#include <cstdlib>    // std::calloc, std::free
 #include <functional> // std::hash
 #include <ios>
+#include <iterator>   // std::iterator_traits, std::distance
+#include <limits>     // std::numeric_limits
+#include <stdexcept>  // std::invalid_argument
+#include <tuple>      // std::forward_as_tuple
 #include <utility>    // std::pair
+#include <vector>     // std::vector
 #include <iostream>
+#include <memory>     // std::allocator, std::allocator_traits
+#include <new>        // std::bad_alloc, placement new
+#include <type_traits> // std::is_trivially_destructible, std::void_t
+
+#if defined(__linux__)
+#include <sys/mman.h> // mmap, madvise
+#endif
+
+#include "BucketIndex.h"
+
+// Old buckets moved into the new table by each insert while an incremental rehash is running
+constexpr size_t INCREMENTAL_REHASH_STEP = 8;
+
+// Keys find_batch() hashes and prefetches ahead before it compares any of them
+constexpr size_t FIND_BATCH_SIZE = 16;
+
+// A chain longer than this turns into a tree, and a tree this short or shorter back into a chain
+constexpr size_t TREEIFY_THRESHOLD = 8;
+constexpr size_t UNTREEIFY_THRESHOLD = 6;
+
+// Build with -DUNORDERED_MAP_PROBE_STATS=1 to count the probes of one lookup in PROBE_SAMPLE_PERIOD,
+// reported by UnorderedMap::stats(). Off by default, it costs a thread-local counter per lookup.
+#ifndef UNORDERED_MAP_PROBE_STATS
+#define UNORDERED_MAP_PROBE_STATS 0
+#endif
+
+constexpr size_t PROBE_SAMPLE_PERIOD = 64;
 
-#include "primes.h"
+// Bucket arrays at least this big are mapped directly and backed by huge pages where possible
+constexpr size_t HUGE_PAGE_SIZE = size_t(2) << 20;
 
+namespace unordered_map_detail
+{
+    // Allocators like PoolAllocator that can free every node they handed out in one call
+    template <typename Alloc, typename = void>
+    struct can_release : std::false_type { };
 
+    template <typename Alloc>
+    struct can_release<Alloc, std::void_t<decltype(std::declval<Alloc &>().release()),
+                                          decltype(std::declval<const Alloc &>().releasable())>> : std::true_type { };
 
-template <typename Key, typename T, typename Hash = std::hash<Key>, typename Pred = std::equal_to<Key>>
+    // Hash and Pred that both accept other types than Key, marked by an is_transparent member type
+    template <typename Hash, typename Pred, typename = void>
+    struct is_transparent : std::false_type { };
+
+    template <typename Hash, typename Pred>
+    struct is_transparent<Hash, Pred, std::void_t<typename Hash::is_transparent, typename Pred::is_transparent>> : std::true_type { };
+
+    // A and B compare with < both ways
+    template <typename A, typename B, typename = void>
+    struct is_ordered : std::false_type { };
+
+    template <typename A, typename B>
+    struct is_ordered<A, B, std::void_t<decltype(std::declval<const A &>() < std::declval<const B &>()),
+                                        decltype(std::declval<const B &>() < std::declval<const A &>())>> : std::true_type { };
+
+    // Enables the constructor and insert taking an iterator range, so UnorderedMap(0, 0) still means a bucket count
+    template <typename It>
+    using if_input_iterator = std::enable_if_t<std::is_base_of<std::input_iterator_tag,
+                                                               typename std::iterator_traits<It>::iterator_category>::value, int>;
+
+    // Keys like std::string that may own heap memory beyond sizeof(Key)
+    template <typename Key, typename = void>
+    struct has_capacity : std::false_type { };
+
+    template <typename Key>
+    struct has_capacity<Key, std::void_t<decltype(std::declval<const Key &>().capacity()),
+                                         decltype(std::declval<const Key &>().data()),
+                                         typename Key::value_type>> : std::true_type { };
+
+    // Pred is plain ==, so keys that are neither < nor > each other are exactly the equal ones
+    template <typename Key, typename Pred>
+    struct is_plain_equality : std::integral_constant<bool, std::is_same<Pred, std::equal_to<Key>>::value
+                                                            || std::is_same<Pred, std::equal_to<>>::value> { };
+}
+
+/*
+    A snapshot of how an UnorderedMap is doing, from UnorderedMap::stats(). Probes are the nodes
+    a lookup compares against. Expected probes assume a uniform hash at the current load
+    factor, observed ones come from the chains as they are, so a gap between the two means the
+    hash is spreading keys badly. Observed miss probes are for a missing key that hashes like
+    the stored ones do, the case where a skewed hash hurts.
+*/
+struct UnorderedMapStats {
+    size_t size = 0;
+    size_t bucket_count = 0;
+    double load_factor = 0;
+
+    std::vector<size_t> chain_lengths;  // chain_lengths[n] is the number of buckets holding n nodes
+    size_t longest_chain = 0;
+    size_t tree_buckets = 0;
+    double empty_bucket_ratio = 0;
+
+    double expected_hit_probes = 0;
+    double expected_miss_probes = 0;
+    double observed_hit_probes = 0;
+    double observed_miss_probes = 0;
+
+    size_t bucket_bytes = 0;    // Bucket arrays, and tree roots and nodes of treeified buckets
+    size_t node_bytes = 0;      // The nodes, keys and values included
+    size_t key_bytes = 0;       // The keys in the nodes, plus the heap memory of keys like std::string
+
+    // Lookups sampled since the last reset_probe_samples(), all zero without UNORDERED_MAP_PROBE_STATS
+    size_t sampled_hits = 0;
+    size_t sampled_hit_probes = 0;
+    size_t sampled_misses = 0;
+    size_t sampled_miss_probes = 0;
+    size_t sampled_longest_probe = 0;
+};
+
+// One line of key=value pairs, for logs
+inline std::ostream & operator<<(std::ostream & os, const UnorderedMapStats & stats)
+{
+    os << "size=" << stats.size << " buckets=" << stats.bucket_count << " load_factor=" << stats.load_factor
+       << " longest_chain=" << stats.longest_chain << " tree_buckets=" << stats.tree_buckets
+       << " empty_buckets=" << stats.empty_bucket_ratio
+       << " hit_probes=" << stats.observed_hit_probes << "/" << stats.expected_hit_probes
+       << " miss_probes=" << stats.observed_miss_probes << "/" << stats.expected_miss_probes
+       << " bucket_bytes=" << stats.bucket_bytes << " node_bytes=" << stats.node_bytes << " key_bytes=" << stats.key_bytes;
+
+    if (stats.sampled_hits)
+        {os << " sampled_hit_probes=" << static_cast<double>(stats.sampled_hit_probes) / stats.sampled_hits;}
+    if (stats.sampled_misses)
+        {os << " sampled_miss_probes=" << static_cast<double>(stats.sampled_miss_probes) / stats.sampled_misses;}
+    if (stats.sampled_hits || stats.sampled_misses)
+        {os << " sampled_longest_probe=" << stats.sampled_longest_probe;}
+    return os;
+}
+
+/*
+    Nodes come from Allocator rebound to the node type, std::allocator by default. With
+    PoolAllocator from NodePool.h they are carved out of slabs owned by the map, and clear()
+    and the destructor free the slabs instead of every node.
+
+    BucketIndex turns hash codes into bucket indices and picks the bucket counts, see
+    BucketIndex.h. The default PrimeModulo gives the same buckets as hash % prime.
+
+    A chain that grows past TREEIFY_THRESHOLD nodes, from a weak hash or hostile keys, gets a
+    balanced tree ordered by (hash, key) on top of it, so lookups and erases in it take
+    O(log n) instead of a walk. The chain stays in place, kept in tree order, so iteration and
+    the bucket interface see an ordinary chain. It needs keys ordered by < and Pred being
+    std::equal_to, otherwise every bucket stays a plain chain.
+*/
+template <typename Key, typename T, typename Hash = std::hash<Key>, typename Pred = std::equal_to<Key>,
+          typename Allocator = std::allocator<std::pair<const Key, T>>, typename BucketIndex = PrimeModulo>
 class UnorderedMap {
     public:
 
@@ -24,32 +175,81 @@ class UnorderedMap {
     using const_pointer = const value_type *;
     using size_type = size_t;
     using difference_type = ptrdiff_t;
+    using allocator_type = Allocator;
 
     private:
 
+    // hash is _hash(val.first), computed once on insert so iteration, erase and rehash never hash again
     struct HashNode {
         HashNode *next;
+        size_t hash;
         value_type val;
 
-        HashNode(HashNode *next = nullptr) : next{next} {}
-        HashNode(const value_type & val, HashNode * next = nullptr) : next { next }, val { val } { }
-        HashNode(value_type && val, HashNode * next = nullptr) : next { next }, val { std::move(val) } { }
+        // args go straight to the pair constructor, so the value is built in place
+        template <typename... Args>
+        explicit HashNode(size_t hash, Args &&... args) : next { nullptr }, hash { hash }, val ( std::forward<Args>(args)... ) { }
     };
 
+    using node_allocator = typename std::allocator_traits<Allocator>::template rebind_alloc<HashNode>;
+    using node_traits = std::allocator_traits<node_allocator>;
+
+    // AVL tree over the nodes of one long chain. Trees are rare, so they come from plain new
+    // like the bucket arrays come from calloc, not from Allocator.
+    struct TreeNode {
+        HashNode * node;
+        TreeNode * left = nullptr;
+        TreeNode * right = nullptr;
+        int height = 1;
+
+        explicit TreeNode(HashNode * node) : node { node } { }
+    };
+
+    static constexpr bool _treeifiable = unordered_map_detail::is_ordered<Key, Key>::value
+                                         && unordered_map_detail::is_plain_equality<Key, Pred>::value;
+
+    // Lookups by K can use the trees
+    template <typename K>
+    static constexpr bool _tree_lookup = _treeifiable && unordered_map_detail::is_ordered<K, Key>::value;
+
     size_type _bucket_count;    // Array size, number of linked list total
     HashNode **_buckets;    // Actual array containing all the "Linked list"
 
-    HashNode * _head;   // Points to first NODE, usually in the array index 0
+    // While an incremental rehash runs, buckets [_migrated, _old_bucket_count) of the old array
+    // still hold their nodes, everything else is in _buckets
+    HashNode **_old_buckets = nullptr;
+    size_type _old_bucket_count = 0;
+    size_type _migrated = 0;
+    bool _incremental = false;
+
+    size_type _first_bucket = 0;   // No node in _buckets below this index, a hint for begin()
     size_type _size;    // Number of NODE total
+    float _max_load_factor = 1.0f;  // Grow once _size / _bucket_count would go above this
+    size_type _grow_at = 0;         // Largest size the buckets hold under _max_load_factor, see _update_grow_at
 
     Hash _hash;     // Function that "convert" key into number called hash_code
     key_equal _equal;   //Function that check equivalence
-
-    // This function find the index where the hash_code should be
-    static size_type _range_hash(size_type hash_code, size_type bucket_count) 
-    {
-        return hash_code % bucket_count;
-    }
+    node_allocator _node_alloc;     // Where every HashNode comes from
+
+    // These find the index where the hash_code should be, in _buckets and in _old_buckets
+    BucketIndex _range;
+    BucketIndex _old_range;
+
+    // Tree root of each bucket of _buckets, null for plain chains. Only allocated while some
+    // bucket is a tree, the old array of an incremental rehash never has trees.
+    TreeNode ** _trees = nullptr;
+    size_type _tree_count = 0;
+
+#if UNORDERED_MAP_PROBE_STATS
+    // Relaxed atomics, so sampling keeps concurrent const lookups safe
+    struct ProbeSamples {
+        std::atomic<size_type> hits {0};
+        std::atomic<size_type> hit_probes {0};
+        std::atomic<size_type> misses {0};
+        std::atomic<size_type> miss_probes {0};
+        std::atomic<size_type> longest {0};
+    };
+    mutable ProbeSamples _probe_samples;
+#endif
 
     public:
 
@@ -63,8 +263,8 @@ class UnorderedMap {
         using reference = value_type &;
 
     private:
-        friend class UnorderedMap<Key, T, Hash, key_equal>;
-        using HashNode = typename UnorderedMap<Key, T, Hash, key_equal>::HashNode;
+        friend class UnorderedMap;
+        using HashNode = typename UnorderedMap::HashNode;
 
         const UnorderedMap * _map;  // Points to the Unordered map itself
         HashNode * _ptr;    // Points to current node
@@ -94,17 +294,7 @@ class UnorderedMap {
 
             else
             {
-                size_type index = _map->_bucket(_ptr->val)+1;
-
-                while(!_map -> _buckets[index] && index < _map->_bucket_count)
-                    {index++;}
-
-                // Set to null in case there are "junk" in the memory right after array
-                if(index == _map->_bucket_count)
-                    {_ptr = nullptr;}
-
-                else
-                    {_ptr = _map -> _buckets[index];}
+                _ptr = _map -> _next_bucket_node(_ptr);
             }
             return *this;
         }
@@ -133,8 +323,8 @@ class UnorderedMap {
             using reference = value_type &;
 
         private:
-            friend class UnorderedMap<Key, T, Hash, key_equal>;
-            using HashNode = typename UnorderedMap<Key, T, Hash, key_equal>::HashNode;
+            friend class UnorderedMap;
+            using HashNode = typename UnorderedMap::HashNode;
 
             HashNode * _node;
 
@@ -178,41 +368,948 @@ class UnorderedMap {
 
 private:
 
-    size_type _bucket(size_t code) const {return _range_hash(code, _bucket_count);}
-    size_type _bucket(const Key & key) const {return _bucket(_hash(key));}
-    size_type _bucket(const value_type & val) const {return _bucket(_hash(val.first));}
+    size_type _bucket_of_code(size_t code) const {return _range(code);}
+    size_type _bucket(const Key & key) const {return _bucket_of_code(_hash(key));}
+
+    template <typename... Args>
+    HashNode * _new_node(Args &&... args)
+    {
+        HashNode * node = node_traits::allocate(_node_alloc, 1);
+        try
+        {
+            ::new (static_cast<void *>(node)) HashNode(std::forward<Args>(args)...);
+        }
+        catch (...)
+        {
+            node_traits::deallocate(_node_alloc, node, 1);
+            throw;
+        }
+        return node;
+    }
+
+    void _delete_node(HashNode * node)
+    {
+        node -> ~HashNode();
+        node_traits::deallocate(_node_alloc, node, 1);
+    }
+
+    // Destroy every node and empty every bucket. A releasable allocator frees all nodes in one call,
+    // and if the values need no destructor the chains are not even walked.
+    void _destroy_nodes()
+    {
+        bool release = false;
+        if constexpr (unordered_map_detail::can_release<node_allocator>::value)
+            {release = _node_alloc.releasable();}
+
+        auto destroy_chains = [&](HashNode ** buckets, size_type begin, size_type end) {
+            for (size_type i = begin; i < end; i++)
+            {
+                HashNode * node = buckets[i];
+                while (node)
+                {
+                    HashNode * next = node -> next;
+                    if (release)
+                        {node -> ~HashNode();}
+                    else
+                        {_delete_node(node);}
+                    node = next;
+                }
+                buckets[i] = nullptr;
+            }
+        };
+
+        if (!release || !std::is_trivially_destructible<value_type>::value)
+        {
+            if (_old_buckets)
+                {destroy_chains(_old_buckets, _migrated, _old_bucket_count);}
+            destroy_chains(_buckets, _first_bucket, _bucket_count);
+        }
+        else
+        {
+            std::fill(_buckets, _buckets + _bucket_count, nullptr);
+        }
+
+        if constexpr (unordered_map_detail::can_release<node_allocator>::value)
+        {
+            if (release)
+                {_node_alloc.release();}
+        }
+    }
+
+    static size_type _mapped_bytes(size_type count)
+    {
+        return (count * sizeof(HashNode *) + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+    }
+
+    static bool _is_mapped(size_type count)
+    {
+#if defined(__linux__)
+        return count * sizeof(HashNode *) >= HUGE_PAGE_SIZE;
+#else
+        return false;
+#endif
+    }
 
-    // Member function of Unordered map, therefore have access to _buckets. Not sure why code is in the argument when index bucket is given
-    HashNode*& _find(size_type code, size_type bucket, const Key & key) 
+    /*
+        Bucket arrays are zeroed by the OS rather than by a loop, so a big new table costs nothing
+        until its pages are touched. Big ones are also aligned to and advised for huge pages: an
+        incremental rehash touches the new array at random, and one fault per 2MB instead of per
+        4KB keeps those faults from showing up in the insert latency tail.
+    */
+    static HashNode ** _allocate_buckets(size_type count)
     {
-        HashNode ** node = &_buckets[bucket];
+#if defined(__linux__)
+        if (_is_mapped(count))
+        {
+            // Over-map by one huge page and trim to an aligned range
+            size_type bytes = _mapped_bytes(count);
+            void * mapping = mmap(nullptr, bytes + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (mapping == MAP_FAILED)
+                {throw std::bad_alloc();}
+
+            char * start = static_cast<char *>(mapping);
+            char * aligned = start + (HUGE_PAGE_SIZE - reinterpret_cast<uintptr_t>(start) % HUGE_PAGE_SIZE) % HUGE_PAGE_SIZE;
+            if (aligned != start)
+                {munmap(start, aligned - start);}
+            munmap(aligned + bytes, start + bytes + HUGE_PAGE_SIZE - (aligned + bytes));
+
+            madvise(aligned, bytes, MADV_HUGEPAGE);
+            return reinterpret_cast<HashNode **>(aligned);
+        }
+#endif
+        HashNode ** buckets = static_cast<HashNode **>(std::calloc(count, sizeof(HashNode *)));
+        if (!buckets)
+            {throw std::bad_alloc();}
+        return buckets;
+    }
 
-        while (*node && !_equal((*node) -> val.first,key))
+    static void _free_buckets(HashNode ** buckets, size_type count)
+    {
+        if (!buckets)
+            {return;}
+#if defined(__linux__)
+        if (_is_mapped(count))
+        {
+            munmap(buckets, _mapped_bytes(count));
+            return;
+        }
+#endif
+        std::free(buckets);
+    }
+
+    // Is this hash code still in a bucket of the old array that has not been moved yet
+    bool _in_old_table(size_type code) const
+    {
+        return _old_buckets && _old_range(code) >= _migrated;
+    }
+
+    // The chain a key with this hash code lives in, in whichever table holds it right now
+    HashNode *& _chain(size_type code)
+    {
+        if (_in_old_table(code))
+            {return _old_buckets[_old_range(code)];}
+        return _buckets[_bucket_of_code(code)];
+    }
+
+    // K is Key, or for transparent lookups anything Hash and Pred accept. length gets the number
+    // of chain nodes the probe passed, the whole chain on a miss, and 0 in a tree.
+    template <typename K>
+    HashNode*& _find(size_type code, const K & key, size_type & length)
+    {
+        length = 0;
+        if constexpr (_tree_lookup<K>)
+        {
+            if (_trees && !_in_old_table(code) && _trees[_bucket_of_code(code)])
+                {return _tree_find(_bucket_of_code(code), code, key);}
+        }
+
+        HashNode ** node = &_chain(code);
+        size_type probes = 0;
+
+        // Different cached hashes mean different keys, so Pred only runs on a likely match
+        while (*node && ((*node) -> hash != code || !_equal((*node) -> val.first,key)))
         {
             node = &((*node) -> next);
+            probes++;
         }
 
+        _sample_probes(*node ? probes + 1 : probes, *node != nullptr);
+        length = probes;
         return *node;
     }
+
+    template <typename K>
+    HashNode*& _find(size_type code, const K & key)
+    {
+        size_type length;
+        return _find(code, key, length);
+    }
+
+    // Count one lookup in PROBE_SAMPLE_PERIOD, compiled out without UNORDERED_MAP_PROBE_STATS
+    void _sample_probes([[maybe_unused]] size_type probes, [[maybe_unused]] bool hit) const
+    {
+#if UNORDERED_MAP_PROBE_STATS
+        static thread_local size_type tick = 0;
+        if (++tick % PROBE_SAMPLE_PERIOD)
+            {return;}
+
+        if (hit)
+        {
+            _probe_samples.hits.fetch_add(1, std::memory_order_relaxed);
+            _probe_samples.hit_probes.fetch_add(probes, std::memory_order_relaxed);
+        }
+        else
+        {
+            _probe_samples.misses.fetch_add(1, std::memory_order_relaxed);
+            _probe_samples.miss_probes.fetch_add(probes, std::memory_order_relaxed);
+        }
+
+        size_type longest = _probe_samples.longest.load(std::memory_order_relaxed);
+        while (probes > longest && !_probe_samples.longest.compare_exchange_weak(longest, probes, std::memory_order_relaxed)) { }
+#endif
+    }
     
     // call first find 
-    HashNode*& _find(const Key & key) 
-    {return _find(_hash(key), _bucket(key), key);}
+    template <typename K>
+    HashNode*& _find(const K & key) 
+    {return _find(_hash(key), key);}
+
+    // _find never writes, it is only non-const because callers may relink through the link it returns
+    template <typename K>
+    HashNode * _find_const(const K & key) const
+    {return const_cast<UnorderedMap *>(this) -> _find(key);}
+
+    template <typename K>
+    HashNode * _find_const_code(size_type code, const K & key) const
+    {return const_cast<UnorderedMap *>(this) -> _find(code, key);}
+
+    /*
+        Trees. A tree bucket's chain is sorted by (hash, key) and the tree indexes the same nodes,
+        so the node before any node in the chain is its in-order predecessor, found in O(log n).
+    */
+    template <typename K>
+    static int _compare(size_type code, const K & key, const HashNode * node)
+    {
+        if (code != node -> hash)
+            {return code < node -> hash ? -1 : 1;}
+        if (key < node -> val.first)
+            {return -1;}
+        return node -> val.first < key ? 1 : 0;
+    }
+
+    static int _height(const TreeNode * tree) {return tree ? tree -> height : 0;}
+
+    static void _update_height(TreeNode * tree)
+        {tree -> height = 1 + std::max(_height(tree -> left), _height(tree -> right));}
+
+    static TreeNode * _rotate_left(TreeNode * tree)
+    {
+        TreeNode * right = tree -> right;
+        tree -> right = right -> left;
+        right -> left = tree;
+        _update_height(tree);
+        _update_height(right);
+        return right;
+    }
+
+    static TreeNode * _rotate_right(TreeNode * tree)
+    {
+        TreeNode * left = tree -> left;
+        tree -> left = left -> right;
+        left -> right = tree;
+        _update_height(tree);
+        _update_height(left);
+        return left;
+    }
+
+    // Restore the AVL balance of tree after one of its subtrees changed height by one
+    static TreeNode * _rebalance(TreeNode * tree)
+    {
+        _update_height(tree);
+        int balance = _height(tree -> left) - _height(tree -> right);
+
+        if (balance > 1)
+        {
+            if (_height(tree -> left -> left) < _height(tree -> left -> right))
+                {tree -> left = _rotate_left(tree -> left);}
+            return _rotate_right(tree);
+        }
+        if (balance < -1)
+        {
+            if (_height(tree -> right -> right) < _height(tree -> right -> left))
+                {tree -> right = _rotate_right(tree -> right);}
+            return _rotate_left(tree);
+        }
+        return tree;
+    }
+
+    // added -> node must not be in tree yet
+    static TreeNode * _tree_insert(TreeNode * tree, TreeNode * added)
+    {
+        if (!tree)
+            {return added;}
+
+        if (_compare(added -> node -> hash, added -> node -> val.first, tree -> node) < 0)
+            {tree -> left = _tree_insert(tree -> left, added);}
+        else
+            {tree -> right = _tree_insert(tree -> right, added);}
+        return _rebalance(tree);
+    }
+
+    static TreeNode * _tree_erase_min(TreeNode * tree)
+    {
+        if (!tree -> left)
+            {return tree -> right;}
+        tree -> left = _tree_erase_min(tree -> left);
+        return _rebalance(tree);
+    }
+
+    // Remove the tree node of removed, which must be in tree
+    static TreeNode * _tree_erase(TreeNode * tree, const HashNode * removed)
+    {
+        int order = _compare(removed -> hash, removed -> val.first, tree -> node);
+        if (order < 0)
+            {tree -> left = _tree_erase(tree -> left, removed);}
+        else if (order > 0)
+            {tree -> right = _tree_erase(tree -> right, removed);}
+        else
+        {
+            TreeNode * left = tree -> left;
+            TreeNode * right = tree -> right;
+            delete tree;
+            if (!right)
+                {return left;}
+
+            // The smallest node on the right takes the place of the erased one
+            TreeNode * successor = right;
+            while (successor -> left)
+                {successor = successor -> left;}
+            successor -> right = _tree_erase_min(right);
+            successor -> left = left;
+            return _rebalance(successor);
+        }
+        return _rebalance(tree);
+    }
+
+    static void _tree_destroy(TreeNode * tree)
+    {
+        if (!tree)
+            {return;}
+        _tree_destroy(tree -> left);
+        _tree_destroy(tree -> right);
+        delete tree;
+    }
+
+    // Relink the chain in tree order, link is the bucket slot on the way in
+    static void _tree_relink(const TreeNode * tree, HashNode **& link)
+    {
+        if (!tree)
+            {return;}
+        _tree_relink(tree -> left, link);
+        *link = tree -> node;
+        link = &(tree -> node -> next);
+        _tree_relink(tree -> right, link);
+    }
+
+    // The link pointing at the node of key in tree bucket index, or a null link if it is absent
+    template <typename K>
+    HashNode *& _tree_find(size_type index, size_type code, const K & key)
+    {
+        TreeNode * tree = _trees[index];
+        TreeNode * before = nullptr;    // Last node passed on its right, the predecessor so far
+        size_type probes = 0;
+
+        while (tree)
+        {
+            int order = _compare(code, key, tree -> node);
+            probes++;
+            if (order == 0)
+            {
+                _sample_probes(probes, true);
+                if (tree -> left)
+                {
+                    before = tree -> left;
+                    while (before -> right)
+                        {before = before -> right;}
+                }
+                return before ? before -> node -> next : _buckets[index];
+            }
+
+            if (order < 0)
+                {tree = tree -> left;}
+            else
+            {
+                before = tree;
+                tree = tree -> right;
+            }
+        }
+
+        _sample_probes(probes, false);
+
+        // The next of the last node in the chain is null
+        TreeNode * last = _trees[index];
+        while (last -> right)
+            {last = last -> right;}
+        return last -> node -> next;
+    }
+
+    // Build a tree over the chain of bucket index and sort the chain. Trees are only an
+    // optimization, if memory runs out the bucket stays a chain.
+    void _treeify(size_type index)
+    {
+        if (!_trees)
+        {
+            _trees = static_cast<TreeNode **>(std::calloc(_bucket_count, sizeof(TreeNode *)));
+            if (!_trees)
+                {return;}
+        }
+
+        TreeNode * root = nullptr;
+        for (HashNode * node = _buckets[index]; node; node = node -> next)
+        {
+            TreeNode * added = new (std::nothrow) TreeNode(node);
+            if (!added)
+            {
+                _tree_destroy(root);
+                _release_trees_if_unused();
+                return;
+            }
+            root = _tree_insert(root, added);
+        }
+
+        HashNode ** link = &_buckets[index];
+        _tree_relink(root, link);
+        *link = nullptr;
+
+        _trees[index] = root;
+        _tree_count++;
+    }
+
+    void _untreeify(size_type index)
+    {
+        _tree_destroy(_trees[index]);
+        _trees[index] = nullptr;
+        _tree_count--;
+        _release_trees_if_unused();
+    }
+
+    void _release_trees_if_unused()
+    {
+        if (_tree_count == 0)
+        {
+            std::free(_trees);
+            _trees = nullptr;
+        }
+    }
+
+    void _free_trees()
+    {
+        if (!_trees)
+            {return;}
+        for (size_type i = 0; i < _bucket_count; i++)
+            {_tree_destroy(_trees[i]);}
+        _tree_count = 0;
+        _release_trees_if_unused();
+    }
+
+    // Does the chain of bucket index have more than length nodes
+    bool _chain_longer_than(size_type index, size_type length) const
+    {
+        HashNode * node = _buckets[index];
+        for (size_type i = 0; node && i < length; i++)
+            {node = node -> next;}
+        return node != nullptr;
+    }
+
+    // Treeify bucket index of _buckets if its chain has grown too long
+    void _treeify_if_needed(size_type index)
+    {
+        if constexpr (_treeifiable)
+        {
+            if (!(_trees && _trees[index]) && _chain_longer_than(index, TREEIFY_THRESHOLD))
+                {_treeify(index);}
+        }
+    }
+
+    // Same, for a caller that has just counted the chain's length
+    void _treeify_if_needed(size_type index, size_type length)
+    {
+        if constexpr (_treeifiable)
+        {
+            if (length > TREEIFY_THRESHOLD && !(_trees && _trees[index]))
+                {_treeify(index);}
+        }
+    }
+
+    // Add node to tree bucket index, after its predecessor in the chain
+    void _tree_link(size_type index, HashNode * node)
+    {
+        TreeNode * added = new (std::nothrow) TreeNode(node);
+        if (!added)
+        {
+            _untreeify(index);
+            node -> next = _buckets[index];
+            _buckets[index] = node;
+            return;
+        }
+
+        TreeNode * before = nullptr;
+        for (TreeNode * tree = _trees[index]; tree; )
+        {
+            if (_compare(node -> hash, node -> val.first, tree -> node) < 0)
+                {tree = tree -> left;}
+            else
+            {
+                before = tree;
+                tree = tree -> right;
+            }
+        }
+
+        HashNode *& link = before ? before -> node -> next : _buckets[index];
+        node -> next = link;
+        link = node;
+        _trees[index] = _tree_insert(_trees[index], added);
+    }
+
+    // Unlink the node link points at and delete it, link comes from _find or _link_to
+    void _erase_link(HashNode *& link)
+    {
+        HashNode * node = link;
+        link = node -> next;
+
+        if constexpr (_treeifiable)
+        {
+            if (_trees && !_in_old_table(node -> hash))
+            {
+                size_type index = _bucket_of_code(node -> hash);
+                if (_trees[index])
+                {
+                    _trees[index] = _tree_erase(_trees[index], node);
+                    if (!_chain_longer_than(index, UNTREEIFY_THRESHOLD))
+                        {_untreeify(index);}
+                }
+            }
+        }
+
+        _delete_node(node);
+        _size--;
+    }
+
+    // Height of tree, adding the depth of every node (the root is 1) to depth_sum
+    static size_type _tree_depths(const TreeNode * tree, size_type depth, size_type & depth_sum, size_type & tree_nodes)
+    {
+        if (!tree)
+            {return depth - 1;}
+        depth_sum += depth;
+        tree_nodes++;
+        return std::max(_tree_depths(tree -> left, depth + 1, depth_sum, tree_nodes),
+                        _tree_depths(tree -> right, depth + 1, depth_sum, tree_nodes));
+    }
+
+    static size_type _key_heap_bytes([[maybe_unused]] const Key & key)
+    {
+        if constexpr (unordered_map_detail::has_capacity<Key>::value)
+        {
+            // Short strings live inside the object itself
+            const void * data = key.data();
+            if (data >= static_cast<const void *>(&key) && data < static_cast<const void *>(&key + 1))
+                {return 0;}
+            return key.capacity() * sizeof(typename Key::value_type);
+        }
+        return 0;
+    }
+
+    // The link pointing at node, which is in the map
+    HashNode *& _link_to(HashNode * node)
+    {
+        if constexpr (_treeifiable)
+            {return _find(node -> hash, node -> val.first);}
+
+        HashNode ** link = &_chain(node -> hash);
+        while (*link != node)
+            {link = &((*link) -> next);}
+        return *link;
+    }
+
+    /*
+        Look up n keys in three passes over groups of FIND_BATCH_SIZE: hash every key and prefetch
+        its bucket slot, then load the slots and prefetch the chain heads, then walk the chains.
+        A lookup in a table much bigger than the cache misses once on the slot and once per node,
+        here the misses of a whole group are in flight together instead of one after another.
+    */
+    template <typename K, typename It>
+    void _find_batch(const K * keys, size_type n, It * out) const
+    {
+        size_type codes[FIND_BATCH_SIZE];
+        HashNode * const * slots[FIND_BATCH_SIZE];
+
+        for (size_type begin = 0; begin < n; begin += FIND_BATCH_SIZE)
+        {
+            size_type count = std::min(FIND_BATCH_SIZE, n - begin);
+
+            for (size_type i = 0; i < count; i++)
+            {
+                codes[i] = _hash(keys[begin + i]);
+                slots[i] = &const_cast<UnorderedMap *>(this) -> _chain(codes[i]);
+                __builtin_prefetch(slots[i]);
+            }
+
+            for (size_type i = 0; i < count; i++)
+            {
+                if (*slots[i])
+                    {__builtin_prefetch(*slots[i]);}
+            }
+
+            for (size_type i = 0; i < count; i++)
+            {
+                if constexpr (_tree_lookup<K>)
+                {
+                    if (_trees)
+                    {
+                        out[begin + i] = It(this, _find_const_code(codes[i], keys[begin + i]));
+                        continue;
+                    }
+                }
+
+                HashNode * node = *slots[i];
+                while (node && (node -> hash != codes[i] || !_equal(node -> val.first, keys[begin + i])))
+                    {node = node -> next;}
+                out[begin + i] = It(this, node);
+            }
+        }
+    }
+
+    template <typename K>
+    size_type _erase_key(const K & key)
+    {
+        // _find returns the link pointing at the node, so unlinking is one assignment
+        HashNode *& link = _find(key);
+
+        if (!link)
+            {return 0;}
+
+        _erase_link(link);
+        return 1;
+    }
 
-    // Add new node with move semantic, take care of cases where insert at _head or head is uninitialized
-    HashNode * _insert_into_bucket(size_type bucket, value_type && value) 
+    // Hash key once, probe once, and only when it is absent build a node from args (which construct
+    // a value_type with that key). key may refer into args, nothing is moved out before the probe.
+    template <typename K, typename... Args>
+    std::pair<iterator, bool> _emplace_unique(const K & key, Args &&... args)
     {
-        HashNode * temp = new HashNode(std::move(value));
+        size_type code = _hash(key);
+        size_type chain_length;
+        HashNode * exist = _find(code, key, chain_length);
 
-        temp -> next = _buckets[_bucket(value)];
-        _buckets[_bucket(value)] = temp;
+        if (exist)
+            {return {iterator(this,exist),false};}
+
+        return {iterator(this,_insert_node(code, _new_node(code, std::forward<Args>(args)...), chain_length)),true};
+    }
+
+    // Build the node first to learn its key, the general emplace
+    template <typename... Args>
+    std::pair<iterator, bool> _emplace_node(Args &&... args)
+    {
+        HashNode * node = _new_node(0, std::forward<Args>(args)...);
+        size_type code = _hash(node -> val.first);
+        size_type chain_length;
+        HashNode * exist = _find(code, node -> val.first, chain_length);
+
+        if (exist)
+        {
+            _delete_node(node);
+            return {iterator(this,exist),false};
+        }
+
+        node -> hash = code;
+        return {iterator(this,_insert_node(code, node, chain_length)),true};
+    }
+
+    template <typename K, typename M>
+    std::pair<iterator, bool> _insert_or_assign(K && key, M && obj)
+    {
+        size_type code = _hash(key);
+        size_type chain_length;
+        HashNode * exist = _find(code, key, chain_length);
+
+        if (exist)
+        {
+            exist -> val.second = std::forward<M>(obj);
+            return {iterator(this,exist),false};
+        }
+
+        return {iterator(this,_insert_node(code, _new_node(code, std::forward<K>(key), std::forward<M>(obj)), chain_length)),true};
+    }
+
+    // Enables the K overloads of find, contains, count and erase: only with a transparent Hash and
+    // Pred, and never for iterators so erase(iterator) keeps its meaning
+    template <typename K>
+    using _if_transparent = std::enable_if_t<unordered_map_detail::is_transparent<Hash, Pred>::value
+                                             && !std::is_convertible<K, iterator>::value
+                                             && !std::is_convertible<K, const_iterator>::value, int>;
+
+    /*
+        Iteration order is the old buckets that still hold nodes, then the new array.
+        These return the first node at or after a position in that order.
+    */
+    HashNode * _first_node_from_new(size_type index) const
+    {
+        index = std::max(index, _first_bucket);
+        while (index < _bucket_count && !_buckets[index])
+            {index++;}
+        return index < _bucket_count ? _buckets[index] : nullptr;
+    }
+
+    HashNode * _first_node_from_old(size_type index) const
+    {
+        while (index < _old_bucket_count && !_old_buckets[index])
+            {index++;}
+        if (index < _old_bucket_count)
+            {return _old_buckets[index];}
+        return _first_node_from_new(0);
+    }
+
+    HashNode * _first_node() const
+    {
+        if (_old_buckets)
+            {return _first_node_from_old(_migrated);}
+        return _first_node_from_new(0);
+    }
+
+    // First node of the bucket after the one node is in, used by the iterator at the end of a chain
+    HashNode * _next_bucket_node(HashNode * node) const
+    {
+        size_type code = node -> hash;
+        if (_in_old_table(code))
+            {return _first_node_from_old(_old_range(code) + 1);}
+        return _first_node_from_new(_bucket_of_code(code) + 1);
+    }
+
+    // Push node onto the front of its chain in the new array, or into its tree, and return the bucket
+    size_type _link_into_new(HashNode * node, size_type code)
+    {
+        size_type index = _bucket_of_code(code);
+        if constexpr (_treeifiable)
+        {
+            if (_trees && _trees[index])
+            {
+                _tree_link(index, node);
+                return index;
+            }
+        }
+
+        node -> next = _buckets[index];
+        _buckets[index] = node;
+        _first_bucket = std::min(_first_bucket, index);
+        return index;
+    }
+
+    // Move up to count old buckets into the new array, freeing the old one when it is empty
+    void _migrate(size_type count)
+    {
+        size_type stop = std::min(_old_bucket_count, _migrated + count);
+        for (; _migrated < stop; _migrated++)
+        {
+            // A chain long enough to have had a tree may leave long chains behind it, treeify them again
+            HashNode * node = _old_buckets[_migrated];
+            for (size_type moved = 1; node; moved++)
+            {
+                HashNode * next = node -> next;
+                size_type index = _link_into_new(node, node -> hash);
+                if (moved > TREEIFY_THRESHOLD)
+                    {_treeify_if_needed(index);}
+                node = next;
+            }
+        }
+
+        if (_migrated == _old_bucket_count)
+        {
+            _free_buckets(_old_buckets, _old_bucket_count);
+            _old_buckets = nullptr;
+            _old_bucket_count = 0;
+            _migrated = 0;
+        }
+    }
+
+    // Finish a running incremental rehash in one go
+    void _finish_migration()
+    {
+        if (_old_buckets)
+            {_migrate(_old_bucket_count);}
+    }
+
+    // Smallest bucket count that holds count elements without going over the max load factor
+    size_type _buckets_for(size_type count) const
+    {
+        return static_cast<size_type>(std::ceil(static_cast<double>(count) / _max_load_factor));
+    }
+
+    // Recompute _grow_at after _bucket_count or _max_load_factor changed, so inserts compare sizes
+    // instead of dividing. It agrees exactly with _buckets_for, which reserve() sizes the table by.
+    void _update_grow_at()
+    {
+        double estimate = static_cast<double>(_bucket_count) * _max_load_factor;
+        if (estimate >= static_cast<double>(std::numeric_limits<size_type>::max() / 2))
+        {
+            _grow_at = std::numeric_limits<size_type>::max();
+            return;
+        }
 
-        if (_head == nullptr || _bucket(value.first) <= _bucket(_head -> val.first))
+        size_type grow_at = static_cast<size_type>(estimate);
+        while (grow_at > 0 && _buckets_for(grow_at) > _bucket_count)
+            {grow_at--;}
+        while (_buckets_for(grow_at + 1) <= _bucket_count)
+            {grow_at++;}
+        _grow_at = grow_at;
+    }
+
+    // Called before adding one node, doubles the table (rounded by BucketIndex) when it would be too full.
+    // In incremental mode the nodes are moved a few buckets at a time by the following inserts.
+    void _grow_if_needed()
+    {
+        if (_size + 1 > _grow_at)
+        {
+            size_type bucket_count = BucketIndex::round_bucket_count(std::max(_bucket_count * 2, _buckets_for(_size + 1)));
+            if (_incremental)
+                {_start_migration(bucket_count);}
+            else
+                {_relink(bucket_count);}
+        }
+        else if (_old_buckets)
+        {
+            _migrate(INCREMENTAL_REHASH_STEP);
+        }
+    }
+
+    // Make the current array the old one and start filling an empty array of bucket_count.
+    // Trees only index the new array, the old one keeps their buckets as plain sorted chains
+    // and _migrate builds trees again where the moved chains are still long.
+    void _start_migration(size_type bucket_count)
+    {
+        // Only happens if the last rehash could not keep up (max_load_factor below 1 / step)
+        _finish_migration();
+
+        // Allocate before touching anything, so a throw leaves the map as it was
+        HashNode ** buckets = _allocate_buckets(bucket_count);
+        _free_trees();
+        _old_buckets = _buckets;
+        _old_bucket_count = _bucket_count;
+        _old_range = _range;
+        _migrated = 0;
+        _buckets = buckets;
+        _bucket_count = bucket_count;
+        _range = BucketIndex(bucket_count);
+        _first_bucket = bucket_count;
+        _update_grow_at();
+    }
+
+    // Move every node into a new array of bucket_count buckets, nodes are relinked, never copied
+    void _relink(size_type bucket_count)
+    {
+        _finish_migration();
+        HashNode ** buckets = _allocate_buckets(bucket_count);
+        bool had_trees = _trees != nullptr;
+        _free_trees();
+        BucketIndex range(bucket_count);
+
+        for (size_type i = 0; i < _bucket_count; i++)
+        {
+            HashNode * node = _buckets[i];
+            while (node)
+            {
+                HashNode * next = node -> next;
+                size_type index = range(node -> hash);
+                node -> next = buckets[index];
+                buckets[index] = node;
+                node = next;
+            }
+        }
+
+        _free_buckets(_buckets, _bucket_count);
+        _buckets = buckets;
+        _bucket_count = bucket_count;
+        _range = range;
+        _first_bucket = 0;
+        _update_grow_at();
+
+        // Colliding keys still collide in the new array, give their chains trees again
+        if (had_trees)
+        {
+            for (size_type i = 0; i < _bucket_count; i++)
+                {_treeify_if_needed(i);}
+        }
+    }
+
+    // Add a new node for a key that is not in the map yet, growing the table first if needed.
+    // chain_length is the length of its chain as the probe for the key counted it.
+    // Takes ownership of node, it is freed if growing throws.
+    HashNode * _insert_node(size_type code, HashNode * node, size_type chain_length)
+    {
+        // Rehashing or moving old buckets relinks chains, after that the probe's count is stale
+        bool relinks = _old_buckets || _size + 1 > _grow_at;
+        try
+        {
+            _grow_if_needed();
+        }
+        catch (...)
+        {
+            _delete_node(node);
+            throw;
+        }
+
+        if (_in_old_table(code))
         {
-            _head = temp;
+            HashNode *& chain = _chain(code);
+            node -> next = chain;
+            chain = node;
+        }
+        else
+        {
+            size_type index = _link_into_new(node, code);
+            if (relinks)
+                {_treeify_if_needed(index);}
+            else
+                {_treeify_if_needed(index, chain_length + 1);}
         }
         _size++;
-        return temp;
+        return node;
+    }
+
+    /*
+        Fill the empty _buckets, sized like other's, with copies of other's nodes. Keys are known
+        to be unique and their hashes are cached, so nothing is hashed or compared: every chain
+        is copied in order into the same bucket, and the nodes of an unfinished incremental
+        rehash go straight to their bucket in the new array. Long chains get their trees again.
+    */
+    void _clone_nodes(const UnorderedMap & other)
+    {
+        _first_bucket = 0;
+        for (size_type i = 0; i < other._bucket_count; i++)
+        {
+            HashNode ** tail = &_buckets[i];
+            for (const HashNode * node = other._buckets[i]; node; node = node -> next)
+            {
+                *tail = _new_node(node -> hash, node -> val);
+                tail = &((*tail) -> next);
+                _size++;
+            }
+        }
+
+        for (size_type i = other._migrated; i < other._old_bucket_count; i++)
+        {
+            for (const HashNode * node = other._old_buckets[i]; node; node = node -> next)
+            {
+                _link_into_new(_new_node(node -> hash, node -> val), node -> hash);
+                _size++;
+            }
+        }
+
+        if (other._trees || other._old_buckets)
+        {
+            for (size_type i = 0; i < _bucket_count; i++)
+                {_treeify_if_needed(i);}
+        }
     }
 
     void _move_content(UnorderedMap & src, UnorderedMap & dst) {
@@ -220,114 +1317,154 @@ private:
         // Transfer everything to dst
         dst._bucket_count = src._bucket_count;
         dst._buckets = src._buckets;
-        dst._head = src._head;
+        dst._old_buckets = src._old_buckets;
+        dst._old_bucket_count = src._old_bucket_count;
+        dst._range = src._range;
+        dst._old_range = src._old_range;
+        dst._migrated = src._migrated;
+        dst._incremental = src._incremental;
+        dst._first_bucket = src._first_bucket;
         dst._size = src._size;
         dst._hash = std::move(src._hash);
         dst._equal = std::move(src._equal);
+        dst._node_alloc = std::move(src._node_alloc);
+        dst._max_load_factor = src._max_load_factor;
+        dst._grow_at = src._grow_at;
+        dst._trees = src._trees;
+        dst._tree_count = src._tree_count;
 
         // Clear src data
-        src._buckets = new HashNode*[src._bucket_count]();
-        src._head = nullptr;
+        src._buckets = _allocate_buckets(src._bucket_count);
+        src._old_buckets = nullptr;
+        src._old_bucket_count = 0;
+        src._migrated = 0;
+        src._first_bucket = 0;
         src._size = 0;
+        src._trees = nullptr;
+        src._tree_count = 0;
     }
 
 public:
 
-    // Default Constructor - creates prime number of empty linkedlist array
-    explicit UnorderedMap(size_type bucket_count, const Hash & hash = Hash { }, const key_equal & equal = key_equal { }) 
+    // Default Constructor - creates an array of empty linkedlists, sized by BucketIndex
+    explicit UnorderedMap(size_type bucket_count, const Hash & hash = Hash { }, const key_equal & equal = key_equal { },
+                          const allocator_type & alloc = allocator_type { })
+        : _hash(hash), _equal(equal), _node_alloc(alloc)
     {
-        _bucket_count = next_greater_prime(bucket_count);
-        _buckets = new HashNode * [_bucket_count]();
+        _bucket_count = BucketIndex::round_bucket_count(bucket_count);
+        _range = BucketIndex(_bucket_count);
+        _buckets = _allocate_buckets(_bucket_count);
         _size = 0;
-        _head = nullptr;
-        _hash = hash;
-        _equal = equal;
+        _update_grow_at();
     }
 
     ~UnorderedMap() 
     {
         clear();
-        delete[] _buckets;
+        _free_buckets(_buckets, _bucket_count);
         _buckets = nullptr;
         _bucket_count = 0;
         _size = 0;
     }
 
-    // Copy constructor - copy everything, and traverse array, 
-    // inserting elements into linkedlist without caring about order
+    // Build from a range, inserting the elements whose key is not there yet. bucket_count is only a
+    // minimum, with forward iterators the table is sized for the whole range before the first insert.
+    template <typename InputIt, unordered_map_detail::if_input_iterator<InputIt> = 0>
+    UnorderedMap(InputIt first, InputIt last, size_type bucket_count = 0, const Hash & hash = Hash { },
+                 const key_equal & equal = key_equal { }, const allocator_type & alloc = allocator_type { })
+        : UnorderedMap(bucket_count, hash, equal, alloc)
+    {insert(first, last);}
+
+    // Copy constructor - same bucket count, every chain cloned as it is, see _clone_nodes
     UnorderedMap(const UnorderedMap & other) 
+        : _hash(other._hash), _equal(other._equal),
+          _node_alloc(node_traits::select_on_container_copy_construction(other._node_alloc))
     {
-        _hash = other._hash;
-        _equal = other._equal;
+        _max_load_factor = other._max_load_factor;
+        _grow_at = other._grow_at;
+        _incremental = other._incremental;
         _size = 0;
-        _head = nullptr;
         _bucket_count = other._bucket_count;
-        _buckets = new HashNode * [_bucket_count]();
-        
-        for (size_type i = 0; i < _bucket_count; i++){
-            HashNode * traverse = other._buckets[i];
+        _range = other._range;
+        _buckets = _allocate_buckets(_bucket_count);
 
-            while (traverse){
-                insert(traverse -> val);
-                traverse = traverse ->next;
-            }
+        try
+        {
+            _clone_nodes(other);
+        }
+        catch (...)
+        {
+            clear();
+            _free_buckets(_buckets, _bucket_count);
+            throw;
         }
     }
 
     UnorderedMap(UnorderedMap && other) 
+        : _hash(other._hash), _equal(other._equal)
     {_move_content(other, *this);}
 
-    // Operator copy - For some reason must do it manually, can't clear() and call copy constructor
+    // Operator copy - drop everything, take other's bucket count and clone its chains. If a copy
+    // throws, the map is left empty.
     UnorderedMap & operator=(const UnorderedMap & other) 
     {
         if (other._buckets == _buckets)
         {return *this;}
 
+        HashNode ** buckets = _allocate_buckets(other._bucket_count);
         clear();
-        delete [] _buckets;
+        _free_buckets(_buckets, _bucket_count);
 
         _hash = other._hash;
         _equal = other._equal;
+        _max_load_factor = other._max_load_factor;
+        _grow_at = other._grow_at;
+        _incremental = other._incremental;
         _size = 0;
-        _head = nullptr;
         _bucket_count = other._bucket_count;
-        _buckets = new HashNode * [_bucket_count]();
-        
-        for (size_type i = 0; i < _bucket_count; i++){
-            HashNode * traverse = other._buckets[i];
+        _range = other._range;
+        _buckets = buckets;
+        _first_bucket = 0;
 
-            while (traverse){
-                insert(traverse -> val);
-                traverse = traverse ->next;
-            }
+        try
+        {
+            _clone_nodes(other);
         }
+        catch (...)
+        {
+            clear();
+            throw;
+        }
+        return *this;
     }
 
-    // Operator Move - call destructor and _move_content
+    // Operator Move - free everything, then _move_content (the allocator moves along with the nodes)
     UnorderedMap & operator=(UnorderedMap && other) 
     {
         if (other._buckets == _buckets)
             {return *this;}
-        this -> ~UnorderedMap();
+        clear();
+        _free_buckets(_buckets, _bucket_count);
         _move_content(other, *this);
-        
+        return *this;
     }
 
-    // Check each linked list for nonempty then traverse and delete
+    // Delete every node and empty the buckets, the bucket count stays the same
     void clear() noexcept 
     {
-        if (_size <= 0)
+        // Erasing everything during an incremental rehash leaves the old array to free
+        if (_size == 0 && !_old_buckets)
             {return;}
 
-        iterator traverse = iterator(this,_head);
-        
-        while(traverse != this -> end())
-        {
-            basic_iterator temp = traverse;
-            traverse++;
-            delete temp._ptr;
-            _size--;
-        }
+        _free_trees();
+        _destroy_nodes();
+        _size = 0;
+        _first_bucket = _bucket_count;
+
+        _free_buckets(_old_buckets, _old_bucket_count);
+        _old_buckets = nullptr;
+        _old_bucket_count = 0;
+        _migrated = 0;
     }
 
     size_type size() const noexcept {return _size;}
@@ -336,17 +1473,36 @@ public:
 
     size_type bucket_count() const noexcept {return _bucket_count;}
 
-    iterator begin() {return iterator(this,_head);}
+    hasher hash_function() const {return _hash;}
+
+    key_equal key_eq() const {return _equal;}
+
+    // Only the non-const begin() raises the hint, so const iteration writes nothing and
+    // concurrent readers of a const map stay race free
+    iterator begin()
+    {
+        HashNode * node = _first_node();
+        if (node && !_old_buckets)
+            {_first_bucket = _bucket_of_code(node -> hash);}
+        return iterator(this,node);
+    }
+
     iterator end() {return iterator(this,nullptr);}
 
-    const_iterator cbegin() const {return iterator(this,_head);}
-    const_iterator cend() const {return iterator(this,nullptr);}
+    const_iterator cbegin() const {return const_iterator(this,_first_node());}
+    const_iterator cend() const {return const_iterator(this,nullptr);}
 
-    local_iterator begin(size_type n) {return local_iterator(_buckets[n]);}
+    // The bucket interface only sees the new array, so it finishes a running incremental rehash
+    local_iterator begin(size_type n) 
+    {
+        _finish_migration();
+        return local_iterator(_buckets[n]);
+    }
     local_iterator end(size_type n) {return local_iterator(nullptr);}
 
     size_type bucket_size(size_type n) 
     {
+        _finish_migration();
         HashNode * traverse = _buckets[n];
         size_type count = 0;
 
@@ -360,67 +1516,261 @@ public:
 
     float load_factor() const {return float(_size) / _bucket_count;}
 
-    size_type bucket(const Key & key) const {return _bucket(key);}
+    float max_load_factor() const {return _max_load_factor;}
 
-    // return pair with iterator and true or false if inserted or not
-    std::pair<iterator, bool> insert(value_type && value) 
+    // Set the load factor the table grows at, rehashing right away if it is already above it
+    void max_load_factor(float ml)
+    {
+        if (!(ml > 0))
+            {throw std::invalid_argument("max_load_factor must be positive");}
+
+        _max_load_factor = ml;
+        _update_grow_at();
+        if (_buckets_for(_size) > _bucket_count)
+            {rehash(0);}
+    }
+
+    // Use at least count buckets (rounded up by BucketIndex, to a prime by default), but never so
+    // few that the max load factor is exceeded. Existing nodes are relinked into the new buckets,
+    // iterators stay valid but their order changes.
+    void rehash(size_type count)
     {
-        HashNode * exist = _find(value.first);
+        size_type bucket_count = BucketIndex::round_bucket_count(std::max(count, _buckets_for(_size)));
+        if (bucket_count != _bucket_count)
+            {_relink(bucket_count);}
+    }
 
-        if(exist)
+    // Make room for count elements in total without any further rehash
+    void reserve(size_type count)
+        {rehash(_buckets_for(count));}
+
+    /*
+        In incremental mode, growing allocates the new bucket array but leaves the nodes where
+        they are. Each following insert moves INCREMENTAL_REHASH_STEP old buckets over, and
+        lookups check whichever array a key's bucket is in at the moment, so no single insert
+        pays for relinking the whole table. find and erase never move nodes, so a traversal
+        that only erases behaves as usual, while an insert during a traversal reorders it
+        like a rehash does. Explicit rehash() / reserve() still rehash everything at once.
+        Trees are dropped when growing starts and built again as long chains are moved.
+    */
+    void incremental_rehash(bool enabled)
+    {
+        _incremental = enabled;
+        if (!enabled)
+            {_finish_migration();}
+    }
+
+    bool incremental_rehash() const {return _incremental;}
+
+    // True while an incremental rehash still has nodes in the old array
+    bool rehashing() const {return _old_buckets != nullptr;}
+
+    // Walk every bucket and node once and report what the table looks like, see UnorderedMapStats
+    UnorderedMapStats stats() const
+    {
+        UnorderedMapStats stats;
+        stats.size = _size;
+        stats.bucket_count = _bucket_count + _old_bucket_count - _migrated;
+        stats.load_factor = stats.bucket_count ? static_cast<double>(_size) / stats.bucket_count : 0;
+        stats.tree_buckets = _tree_count;
+
+        double hit_probes = 0;
+        double miss_probes = 0;
+        size_type empty = 0;
+        size_type tree_nodes = 0;
+
+        auto visit = [&](HashNode * const * buckets, size_type index, bool in_new) {
+            size_type length = 0;
+            for (HashNode * node = buckets[index]; node; node = node -> next)
+            {
+                length++;
+                stats.key_bytes += _key_heap_bytes(node -> val.first);
+            }
+
+            if (stats.chain_lengths.size() <= length)
+                {stats.chain_lengths.resize(length + 1, 0);}
+            stats.chain_lengths[length]++;
+            stats.longest_chain = std::max(stats.longest_chain, length);
+            empty += length == 0;
+
+            if (in_new && _trees && _trees[index])
+            {
+                size_type depth_sum = 0;
+                size_type height = _tree_depths(_trees[index], 1, depth_sum, tree_nodes);
+                hit_probes += depth_sum;
+                miss_probes += static_cast<double>(length) * height;
+            }
+            else
+            {
+                // Positions 1 to length, and a miss walks the whole chain
+                hit_probes += static_cast<double>(length) * (length + 1) / 2;
+                miss_probes += static_cast<double>(length) * length;
+            }
+        };
+
+        for (size_type i = _migrated; i < _old_bucket_count; i++)
+            {visit(_old_buckets, i, false);}
+        for (size_type i = 0; i < _bucket_count; i++)
+            {visit(_buckets, i, true);}
+
+        stats.empty_bucket_ratio = stats.bucket_count ? static_cast<double>(empty) / stats.bucket_count : 0;
+        if (_size)
         {
-            return {iterator(this,exist),false};
+            double per_bucket = static_cast<double>(_size - 1) / stats.bucket_count;
+            stats.expected_hit_probes = 1 + per_bucket / 2;
+            stats.expected_miss_probes = 1 + per_bucket;
+            stats.observed_hit_probes = hit_probes / _size;
+            stats.observed_miss_probes = miss_probes / _size;
         }
-        
-        return {iterator(this,_insert_into_bucket(_bucket(value), std::move(value))),true};
+
+        stats.bucket_bytes = (_bucket_count + _old_bucket_count) * sizeof(HashNode *)
+                             + (_trees ? _bucket_count * sizeof(TreeNode *) : 0) + tree_nodes * sizeof(TreeNode);
+        stats.node_bytes = _size * sizeof(HashNode);
+        stats.key_bytes += _size * sizeof(Key);
+
+#if UNORDERED_MAP_PROBE_STATS
+        stats.sampled_hits = _probe_samples.hits.load(std::memory_order_relaxed);
+        stats.sampled_hit_probes = _probe_samples.hit_probes.load(std::memory_order_relaxed);
+        stats.sampled_misses = _probe_samples.misses.load(std::memory_order_relaxed);
+        stats.sampled_miss_probes = _probe_samples.miss_probes.load(std::memory_order_relaxed);
+        stats.sampled_longest_probe = _probe_samples.longest.load(std::memory_order_relaxed);
+#endif
+        return stats;
+    }
+
+    void reset_probe_samples()
+    {
+#if UNORDERED_MAP_PROBE_STATS
+        _probe_samples.hits = 0;
+        _probe_samples.hit_probes = 0;
+        _probe_samples.misses = 0;
+        _probe_samples.miss_probes = 0;
+        _probe_samples.longest = 0;
+#endif
     }
 
-    // Same but with copy sematic so have to do manually since helper insert is move semantic only
+    size_type bucket(const Key & key) const {return _bucket(key);}
+
+    // return pair with iterator and true or false if inserted or not
+    std::pair<iterator, bool> insert(value_type && value) 
+        {return _emplace_unique(value.first, std::move(value));}
+
+    // Same but with copy sematic
     std::pair<iterator, bool> insert(const value_type & value) 
+        {return _emplace_unique(value.first, value);}
+
+    // Insert every element of the range whose key is absent. With forward iterators the table grows
+    // once up front, as if no key of the range were in the map yet.
+    template <typename InputIt, unordered_map_detail::if_input_iterator<InputIt> = 0>
+    void insert(InputIt first, InputIt last)
     {
-        HashNode * exist = _find(value.first);
-        size_type index = _bucket(value);
-        
-        if (exist)
+        using category = typename std::iterator_traits<InputIt>::iterator_category;
+        if constexpr (std::is_base_of<std::forward_iterator_tag, category>::value)
         {
-            return {iterator(this,exist),false};
+            size_type count = _size + static_cast<size_type>(std::distance(first, last));
+            if (_buckets_for(count) > _bucket_count)
+                {reserve(count);}
         }
-        
-        exist = new HashNode(value);
-        exist -> next = _buckets[index];
-        _buckets[index] = exist;
-        _size++;
 
-        if(!_head || _bucket(value) <= _bucket(_head -> val))
-        {
-            _head = exist;
-        }
+        for (; first != last; ++first)
+            {insert(*first);}
+    }
 
-        return {iterator(this,exist),true};
+    /*
+        Construct a value_type from args. With a key and a mapped value (the usual emplace(k, v))
+        nothing is built unless the key is absent. Any other arguments must be turned into a
+        node first to find out the key, and the node is thrown away if the key exists.
+    */
+    template <typename... Args>
+    std::pair<iterator, bool> emplace(Args &&... args)
+        {return _emplace_node(std::forward<Args>(args)...);}
+
+    template <typename K, typename M>
+    std::pair<iterator, bool> emplace(K && key, M && obj)
+    {
+        if constexpr (std::is_same<std::decay_t<K>, Key>::value)
+            {return _emplace_unique(key, std::forward<K>(key), std::forward<M>(obj));}
+        else
+            {return _emplace_node(std::forward<K>(key), std::forward<M>(obj));}
     }
 
+    // If key is absent, insert it with a mapped value constructed in place from args, otherwise do nothing at all
+    template <typename... Args>
+    std::pair<iterator, bool> try_emplace(const Key & key, Args &&... args)
+    {
+        return _emplace_unique(key, std::piecewise_construct, std::forward_as_tuple(key),
+                               std::forward_as_tuple(std::forward<Args>(args)...));
+    }
+
+    template <typename... Args>
+    std::pair<iterator, bool> try_emplace(Key && key, Args &&... args)
+    {
+        return _emplace_unique(key, std::piecewise_construct, std::forward_as_tuple(std::move(key)),
+                               std::forward_as_tuple(std::forward<Args>(args)...));
+    }
+
+    // Assign obj to the mapped value of key, inserting key first if it is absent. second is true on insert.
+    template <typename M>
+    std::pair<iterator, bool> insert_or_assign(const Key & key, M && obj)
+        {return _insert_or_assign(key, std::forward<M>(obj));}
+
+    template <typename M>
+    std::pair<iterator, bool> insert_or_assign(Key && key, M && obj)
+        {return _insert_or_assign(std::move(key), std::forward<M>(obj));}
+
     iterator find(const Key & key) 
         {return iterator(this,_find(key));}
 
-    // T() or T{} to get element on the right of assignment operator in : int x = something
-    T& operator[](const Key & key) 
-    {
-        HashNode * node = _find(key);
+    // Lookups on a const map write nothing at all, so any number of threads may run them together
+    const_iterator find(const Key & key) const
+        {return const_iterator(this,_find_const(key));}
 
-        if (node)
-            {return node->val.second;}
+    bool contains(const Key & key) const {return _find_const(key) != nullptr;}
 
-        node = new HashNode(std::make_pair(key,T{}));
-        node -> next = _buckets[_bucket(key)];
-        _buckets[_bucket(key)] = node;
+    size_type count(const Key & key) const {return contains(key);}
 
-        if (!_head || _bucket(key) <= _bucket(_head -> val.first))
-            {_head = node;}
+    /*
+        Transparent lookup: when Hash and Pred both define is_transparent, e.g. fnv1a_hash with
+        std::equal_to<>, a map with std::string keys can be searched with a std::string_view or a
+        const char * and no std::string is built. Hash(k) must equal Hash(Key(k)).
+    */
+    template <typename K, _if_transparent<K> = 0>
+    iterator find(const K & key)
+        {return iterator(this,_find(key));}
 
-        _size++;
+    template <typename K, _if_transparent<K> = 0>
+    const_iterator find(const K & key) const
+        {return const_iterator(this,_find_const(key));}
 
-        return node->val.second;
-    }
+    template <typename K, _if_transparent<K> = 0>
+    bool contains(const K & key) const {return _find_const(key) != nullptr;}
+
+    // out[i] = find(keys[i]) for i < n, with the cache misses of neighbouring keys overlapped,
+    // see _find_batch. Pays off for tables much bigger than the cache and batches of many keys.
+    void find_batch(const Key * keys, size_type n, iterator * out)
+        {_find_batch(keys, n, out);}
+
+    void find_batch(const Key * keys, size_type n, const_iterator * out) const
+        {_find_batch(keys, n, out);}
+
+    template <typename K, _if_transparent<K> = 0>
+    void find_batch(const K * keys, size_type n, iterator * out)
+        {_find_batch(keys, n, out);}
+
+    template <typename K, _if_transparent<K> = 0>
+    void find_batch(const K * keys, size_type n, const_iterator * out) const
+        {_find_batch(keys, n, out);}
+
+    template <typename K, _if_transparent<K> = 0>
+    size_type count(const K & key) const {return contains(key);}
+
+    // T() or T{} to get element on the right of assignment operator in : int x = something
+    // A missing key gets a value-initialized T built directly in its node
+    T& operator[](const Key & key) 
+        {return try_emplace(key).first -> second;}
+
+    T& operator[](Key && key) 
+        {return try_emplace(std::move(key)).first -> second;}
 
     iterator erase(iterator pos) 
     {
@@ -432,75 +1782,18 @@ public:
         iterator it = iterator(this, to_be_erase); // Get iterator next ahead of time to avoid conflict
         it++;
 
-        // Case one where the element to be erase is the head of the linked list, also check if its head
-        if (_buckets[_bucket(to_be_erase -> val)] == to_be_erase)
-        {
-
-            _buckets[_bucket(to_be_erase -> val)] = to_be_erase -> next;
-
-            if(_head == to_be_erase){
-                _head = it._ptr;
-            }
-
-            delete to_be_erase;
-            _size--;
-            return it;
-        }
-
-        // Standard case, no need to worry about head or nullptr next;
-        HashNode * erase_prev = _buckets[_bucket(pos._ptr -> val)];
-
-        while(erase_prev -> next != to_be_erase)
-        {
-            erase_prev = erase_prev -> next;
-        }
-        
-        erase_prev -> next = to_be_erase -> next;
-        delete to_be_erase;
-        _size--;
+        // Find the link pointing at the node, either its bucket or the previous node's next
+        _erase_link(_link_to(to_be_erase));
 
         return it;
     }
 
     size_type erase(const Key & key) 
-    {
-        HashNode * node = _find(key);
-
-        if (!node)
-            {return 0;}
-
-        node = _buckets[_bucket(key)];
-        
-        // Case 1: eraseing node at beginning of linked list
-        if (_equal(node->val.first,key))
-        {
-            iterator it = iterator(this,_buckets[_bucket(key)]);
-            _buckets[_bucket(key)]=node->next;
-
-            if(_head == node)
-            {
-                it++;
-
-                _head = it._ptr;
-            }
+        {return _erase_key(key);}
 
-            delete node;
-            _size--;
-            return 1;
-        }
-        
-        // Standard case
-        while (!_equal((node->next)->val.first, key))
-            {node = node -> next;}
-
-        HashNode * erase_this = node->next;
-        node -> next = erase_this -> next;
-
-        delete erase_this;
-        _size--;
-        return 1;
-        
-    }
+    template <typename K, _if_transparent<K> = 0>
+    size_type erase(const K & key)
+        {return _erase_key(key);}
 
     template<typename KK, typename VV>
     friend void print_map(const UnorderedMap<KK, VV> & map, std::ostream & os);
@@ -511,6 +1804,16 @@ void print_map(const UnorderedMap<K, V> & map, std::ostream & os = std::cout) {
     using size_type = typename UnorderedMap<K, V>::size_type;
     using HashNode = typename UnorderedMap<K, V>::HashNode;
 
+    // Buckets an incremental rehash has not moved yet
+    for(size_type bucket = map._migrated; bucket < map._old_bucket_count; bucket++) {
+        os << "old " << bucket << ": ";
+
+        for(HashNode const * node = map._old_buckets[bucket]; node; node = node->next)
+            os << "(" << node->val.first << ", " << node->val.second << ") ";
+
+        os << std::endl;
+    }
+
     for(size_type bucket = 0; bucket < map.bucket_count(); bucket++) {
         os << bucket << ": ";
 
@@ -0,0 +1,1317 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <list>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "UnorderedMap.h"
+#include "FlatHashMap.h"
+#include "CuckooHashMap.h"
+#include "NodePool.h"
+#include "BucketIndex.h"
+#include "primes.h"
+#include "ConcurrentUnorderedMap.h"
+#include "RcuUnorderedMap.h"
+#include "MappedUnorderedMap.h"
+#include "LRUCache.h"
+#include "hash_functions.h"
+
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/*
+    Benchmarks for UnorderedMap.
+
+    Build with optimizations, e.g. g++ -std=c++17 -O2 -pthread benchmark.cpp primes.cpp hash_functions.cpp
+    Run with no arguments for every benchmark, or pass the name of one benchmark.
+*/
+
+using bench_clock = std::chrono::steady_clock;
+
+// Run f once and return the elapsed time in milliseconds
+template <typename Function>
+static double time_ms(Function && f)
+{
+    bench_clock::time_point start = bench_clock::now();
+    f();
+    return std::chrono::duration<double, std::milli>(bench_clock::now() - start).count();
+}
+
+static std::vector<uint64_t> random_keys(size_t n, std::mt19937_64 & generator)
+{
+    std::vector<uint64_t> keys(n);
+    for (uint64_t & key : keys)
+        {key = generator();}
+    return keys;
+}
+
+// Every global operator new is counted, so benchmarks can report allocations per operation
+static size_t allocation_count = 0;
+
+void * operator new(size_t size)
+{
+    allocation_count++;
+    if (void * p = std::malloc(size ? size : 1))
+        {return p;}
+    throw std::bad_alloc();
+}
+
+// Kept out of line, otherwise GCC sees new paired with free and warns about a mismatch
+__attribute__((noinline)) void operator delete(void * p) noexcept {std::free(p);}
+__attribute__((noinline)) void operator delete(void * p, size_t) noexcept {std::free(p);}
+
+// Results written here cannot be optimized away
+static volatile size_t benchmark_sink;
+
+// Million operations per second
+static double mops(size_t operations, double ms)
+{
+    return operations / ms / 1e3;
+}
+
+static void bench_growth()
+{
+    constexpr size_t SIZES[] = {1000, 10000, 100000, 1000000, 10000000};
+    constexpr size_t MAX_FIXED = 100000;     // A fixed table of 31 buckets is quadratic, skip it above this
+
+    std::mt19937_64 generator(42);
+
+    std::cout << "Insert / find of random uint64 keys starting from 30 buckets, Mops/s" << std::endl;
+    std::cout << "fixed: old behaviour (never rehash), growing: max_load_factor 1" << std::endl;
+    std::cout << std::setw(10) << "keys" << std::setw(14) << "fixed ins" << std::setw(14) << "fixed find"
+              << std::setw(14) << "growing ins" << std::setw(14) << "growing find" << std::setw(12) << "buckets" << std::endl;
+
+    for (size_t n : SIZES)
+    {
+        std::vector<uint64_t> keys = random_keys(n, generator);
+
+        // Insert everything, then find everything, returning the number found
+        auto run = [&](UnorderedMap<uint64_t, uint64_t> & map, double & insert_ms, double & find_ms) {
+            insert_ms = time_ms([&] {
+                for (uint64_t key : keys)
+                    {map.insert({key, key});}
+            });
+            size_t found = 0;
+            find_ms = time_ms([&] {
+                for (uint64_t key : keys)
+                    {found += map.find(key) != map.end();}
+            });
+            return found;
+        };
+
+        std::cout << std::setw(10) << n << std::fixed << std::setprecision(2);
+
+        bool ok = true;
+        if (n <= MAX_FIXED)
+        {
+            UnorderedMap<uint64_t, uint64_t> fixed(30);
+            fixed.max_load_factor(std::numeric_limits<float>::max());
+            double insert_ms = 0, find_ms = 0;
+            ok = ok && run(fixed, insert_ms, find_ms) == n;
+            std::cout << std::setw(14) << mops(n, insert_ms) << std::setw(14) << mops(n, find_ms);
+        }
+        else
+        {
+            std::cout << std::setw(14) << "-" << std::setw(14) << "-";
+        }
+
+        UnorderedMap<uint64_t, uint64_t> growing(30);
+        double insert_ms = 0, find_ms = 0;
+        ok = ok && run(growing, insert_ms, find_ms) == n;
+        std::cout << std::setw(14) << mops(n, insert_ms) << std::setw(14) << mops(n, find_ms)
+                  << std::setw(12) << growing.bucket_count() << (ok ? "" : "  MISSING KEYS")
+                  << std::defaultfloat << std::endl;
+    }
+}
+
+// Value at quantile q of sorted samples
+static double percentile(const std::vector<double> & sorted, double q)
+{
+    return sorted[std::min(sorted.size() - 1, static_cast<size_t>(q * sorted.size()))];
+}
+
+static void bench_incremental_rehash()
+{
+    constexpr size_t N = 10000000;
+
+    std::mt19937_64 generator(7);
+    std::vector<uint64_t> keys = random_keys(N, generator);
+    std::vector<double> latencies(N);
+
+    std::cout << "Latency of each insert while growing to " << N << " keys from 30 buckets, ns" << std::endl;
+    std::cout << std::setw(14) << "rehash" << std::setw(10) << "p50" << std::setw(10) << "p99"
+              << std::setw(10) << "p99.9" << std::setw(12) << "p99.99" << std::setw(14) << "max"
+              << std::setw(12) << "total ms" << std::endl;
+
+    // Both maps stay alive to the end: freeing millions of nodes in between makes the allocator
+    // consolidate its free lists on some later allocation, which would land inside a timed insert
+    UnorderedMap<uint64_t, uint64_t> all_at_once(30);
+    UnorderedMap<uint64_t, uint64_t> incremental(30);
+    incremental.incremental_rehash(true);
+
+    for (UnorderedMap<uint64_t, uint64_t> * map : {&all_at_once, &incremental})
+    {
+        double total = time_ms([&] {
+            for (size_t i = 0; i < N; i++)
+            {
+                bench_clock::time_point start = bench_clock::now();
+                map -> insert({keys[i], i});
+                latencies[i] = std::chrono::duration<double, std::nano>(bench_clock::now() - start).count();
+            }
+        });
+        bool ok = map -> size() == N;
+
+        std::sort(latencies.begin(), latencies.end());
+        std::cout << std::setw(14) << (map -> incremental_rehash() ? "incremental" : "all at once") << std::fixed << std::setprecision(0)
+                  << std::setw(10) << percentile(latencies, 0.5) << std::setw(10) << percentile(latencies, 0.99)
+                  << std::setw(10) << percentile(latencies, 0.999) << std::setw(12) << percentile(latencies, 0.9999)
+                  << std::setw(14) << latencies.back() << std::setw(12) << total << (ok ? "" : "  MISSING KEYS")
+                  << std::defaultfloat << std::endl;
+    }
+
+    // Erasing every key while a migration runs once left the old array behind, and a later copy
+    // assignment then lost its keys and produced an endless iteration
+    UnorderedMap<uint64_t, uint64_t> drained(30);
+    drained.incremental_rehash(true);
+    size_t inserted = 0;
+    for (; !drained.rehashing(); inserted++)
+        {drained.insert({keys[inserted], inserted});}
+    for (size_t i = 0; i < inserted; i++)
+        {drained.erase(keys[i]);}
+
+    UnorderedMap<uint64_t, uint64_t> source(0);
+    for (size_t i = 0; i < 1000; i++)
+        {source.insert({keys[i], i});}
+    drained = source;
+
+    size_t found = 0, visited = 0;
+    for (size_t i = 0; i < 1000; i++)
+        {found += drained.contains(keys[i]);}
+    for (auto it = drained.begin(); it != drained.end() && visited <= 1000; ++it)
+        {visited++;}
+    std::cout << "erase all while rehashing, then copy assign: "
+              << (found == 1000 && visited == 1000 && !drained.rehashing() ? "ok" : "WRONG RESULTS") << std::endl;
+}
+
+// Insert, hit, miss and erase throughput of one map type, in Mops/s
+template <typename Map>
+static void bench_map_operations(const char * name, const std::vector<uint64_t> & keys, const std::vector<uint64_t> & missing)
+{
+    size_t n = keys.size();
+    Map map(30);
+    size_t found = 0;
+
+    double insert_ms = time_ms([&] {
+        for (uint64_t key : keys)
+            {map.insert({key, key});}
+    });
+    double hit_ms = time_ms([&] {
+        for (uint64_t key : keys)
+            {found += map.find(key) != map.end();}
+    });
+    double miss_ms = time_ms([&] {
+        for (uint64_t key : missing)
+            {found += map.find(key) != map.end();}
+    });
+    double erase_ms = time_ms([&] {
+        for (uint64_t key : keys)
+            {found -= map.erase(key);}
+    });
+
+    std::cout << std::setw(22) << name << std::fixed << std::setprecision(2) << std::setw(10) << mops(n, insert_ms)
+              << std::setw(10) << mops(n, hit_ms) << std::setw(10) << mops(n, miss_ms) << std::setw(10) << mops(n, erase_ms)
+              << (found == 0 && map.empty() ? "" : "  WRONG RESULTS") << std::defaultfloat << std::endl;
+}
+
+static void bench_flat_map()
+{
+    constexpr size_t SIZES[] = {10000, 1000000};
+
+    std::mt19937_64 generator(11);
+    for (size_t n : SIZES)
+    {
+        std::vector<uint64_t> keys = random_keys(n, generator);
+        std::vector<uint64_t> missing = random_keys(n, generator);
+
+        std::cout << "uint64 keys, n = " << n << ", Mops/s" << std::endl;
+        std::cout << std::setw(22) << "map" << std::setw(10) << "insert" << std::setw(10) << "hit"
+                  << std::setw(10) << "miss" << std::setw(10) << "erase" << std::endl;
+        bench_map_operations<UnorderedMap<uint64_t, uint64_t>>("UnorderedMap", keys, missing);
+        bench_map_operations<FlatHashMap<uint64_t, uint64_t>>("FlatHashMap", keys, missing);
+        bench_map_operations<std::unordered_map<uint64_t, uint64_t>>("std::unordered_map", keys, missing);
+    }
+}
+
+// Latency of each successful lookup of string keys, in lookup order, written into latencies
+template <typename Map>
+static size_t time_lookups(Map & map, const std::vector<std::string> & queries, std::vector<double> & latencies)
+{
+    size_t found = 0;
+    for (size_t i = 0; i < queries.size(); i++)
+    {
+        bench_clock::time_point start = bench_clock::now();
+        found += map.find(queries[i]) != map.end();
+        latencies[i] = std::chrono::duration<double, std::nano>(bench_clock::now() - start).count();
+    }
+    return found;
+}
+
+static void bench_cuckoo_latency()
+{
+    constexpr size_t N = 1000000;
+
+    std::mt19937_64 generator(23);
+    std::vector<std::string> keys(N);
+    for (std::string & key : keys)
+        {key = "user:" + std::to_string(generator());}
+    std::vector<std::string> queries = keys;
+    std::shuffle(queries.begin(), queries.end(), generator);
+    std::vector<double> latencies(N);
+
+    // Both tables grow from their smallest size, so each sits at whatever load its growth left it
+    UnorderedMap<std::string, size_t, fnv1a_hash> chained(30);
+    CuckooHashMap<std::string, size_t, fnv1a_hash, polynomial_rolling_hash> cuckoo(0, fnv1a_hash{}, polynomial_rolling_hash{1});
+    for (size_t i = 0; i < N; i++)
+    {
+        chained.insert({keys[i], i});
+        cuckoo.insert({keys[i], i});
+    }
+
+    std::cout << "Latency of each successful find among " << N << " string keys, ns" << std::endl;
+    std::cout << std::setw(16) << "map" << std::setw(10) << "p50" << std::setw(10) << "p99"
+              << std::setw(10) << "p99.9" << std::setw(12) << "max" << std::setw(10) << "load" << std::endl;
+
+    auto report = [&](const char * name, size_t found, float load) {
+        std::sort(latencies.begin(), latencies.end());
+        std::cout << std::setw(16) << name << std::fixed << std::setprecision(0) << std::setw(10) << percentile(latencies, 0.5)
+                  << std::setw(10) << percentile(latencies, 0.99) << std::setw(10) << percentile(latencies, 0.999)
+                  << std::setw(12) << latencies.back() << std::setprecision(2) << std::setw(10) << load
+                  << (found == N ? "" : "  MISSING KEYS") << std::defaultfloat << std::endl;
+    };
+
+    report("UnorderedMap", time_lookups(chained, queries, latencies), chained.load_factor());
+    report("CuckooHashMap", time_lookups(cuckoo, queries, latencies), cuckoo.load_factor());
+}
+
+// Node allocation cost and what it does to lookups: inserts into an empty map (one allocation
+// each), erase / insert churn that recycles nodes, then hits, a full traversal and clear()
+template <typename Allocator>
+static void bench_node_allocator(const char * name, const std::vector<uint64_t> & keys, const std::vector<uint64_t> & fresh)
+{
+    using Map = UnorderedMap<uint64_t, uint64_t, std::hash<uint64_t>, std::equal_to<uint64_t>, Allocator>;
+
+    size_t n = keys.size();
+    Map map(30);
+    map.reserve(n);
+    size_t found = 0;
+
+    double insert_ms = time_ms([&] {
+        for (uint64_t key : keys)
+            {map.insert({key, key});}
+    });
+
+    // Replace every other key, so old and new nodes end up interleaved in memory
+    double churn_ms = time_ms([&] {
+        for (size_t i = 0; i < n; i += 2)
+        {
+            map.erase(keys[i]);
+            map.insert({fresh[i], i});
+        }
+    });
+
+    double hit_ms = time_ms([&] {
+        for (size_t i = 0; i < n; i++)
+            {found += map.find(i % 2 ? keys[i] : fresh[i]) != map.end();}
+    });
+
+    uint64_t sum = 0;
+    double iterate_ms = time_ms([&] {
+        for (auto it = map.begin(); it != map.end(); ++it)
+            {sum += it -> second;}
+    });
+
+    double clear_ms = time_ms([&] {map.clear();});
+
+    std::cout << std::setw(26) << name << std::fixed << std::setprecision(2) << std::setw(10) << mops(n, insert_ms)
+              << std::setw(10) << mops(n, churn_ms) << std::setw(10) << mops(n, hit_ms)
+              << std::setw(12) << iterate_ms * 1e6 / n << std::setw(10) << clear_ms
+              << (found == n && sum != 0 && map.empty() ? "" : "  WRONG RESULTS") << std::defaultfloat << std::endl;
+}
+
+static void bench_allocators()
+{
+    constexpr size_t SIZES[] = {100000, 2000000};
+    using value_type = std::pair<const uint64_t, uint64_t>;
+
+    std::mt19937_64 generator(31);
+    for (size_t n : SIZES)
+    {
+        std::vector<uint64_t> keys = random_keys(n, generator);
+        std::vector<uint64_t> fresh = random_keys(n, generator);
+
+        // std::allocator goes last, so it never pays for consolidating a heap the pools fragmented
+        std::cout << "uint64 keys, n = " << n << ", insert / churn / hit in Mops/s, iterate in ns per node, clear in ms" << std::endl;
+        std::cout << std::setw(26) << "allocator" << std::setw(10) << "insert" << std::setw(10) << "churn"
+                  << std::setw(10) << "hit" << std::setw(12) << "iterate" << std::setw(10) << "clear" << std::endl;
+        bench_node_allocator<PoolAllocator<value_type>>("PoolAllocator", keys, fresh);
+        bench_node_allocator<ThreadCachedPoolAllocator<value_type>>("ThreadCachedPoolAllocator", keys, fresh);
+        bench_node_allocator<std::allocator<value_type>>("std::allocator", keys, fresh);
+    }
+}
+
+// The reduction UnorderedMap used before BucketIndex, kept as the baseline
+class PlainModulo {
+    size_t _bucket_count;
+
+public:
+    static size_t round_bucket_count(size_t count) {return next_greater_prime(count);}
+
+    explicit PlainModulo(size_t bucket_count = 1) : _bucket_count{bucket_count} { }
+
+    size_t operator()(size_t hash) const {return hash % _bucket_count;}
+};
+
+// Random lowercase strings of 6 to 16 characters, so the first character hash sees 26 values
+static std::vector<std::string> random_words(size_t n, std::mt19937_64 & generator)
+{
+    std::vector<std::string> words(n);
+    for (std::string & word : words)
+    {
+        size_t length = 6 + generator() % 11;
+        for (size_t i = 0; i < length; i++)
+            {word += static_cast<char>('a' + generator() % 26);}
+    }
+    return words;
+}
+
+template <typename Index>
+static void bench_bucket_index_policy(const char * name, HashType type, const std::vector<std::string> & keys,
+                                      const std::vector<std::string> & queries)
+{
+    using Map = UnorderedMap<std::string, size_t, hash_selector, std::equal_to<std::string>,
+                             std::allocator<std::pair<const std::string, size_t>>, Index>;
+
+    Map map(30, hash_selector(type));
+    size_t found = 0;
+
+    double insert_ms = time_ms([&] {
+        for (size_t i = 0; i < keys.size(); i++)
+            {map.insert({keys[i], i});}
+    });
+    // Several rounds, so the small tables are timed from cache where the reduction cost shows
+    constexpr size_t ROUNDS = 5;
+    double hit_ms = time_ms([&] {
+        for (size_t round = 0; round < ROUNDS; round++)
+        {
+            for (const std::string & key : queries)
+                {found += map.find(key) != map.end();}
+        }
+    });
+
+    size_t longest = 0;
+    for (size_t bucket = 0; bucket < map.bucket_count(); bucket++)
+        {longest = std::max(longest, map.bucket_size(bucket));}
+
+    std::cout << std::setw(20) << name << std::fixed << std::setprecision(2) << std::setw(10) << mops(keys.size(), insert_ms)
+              << std::setw(10) << mops(ROUNDS * queries.size(), hit_ms) << std::setw(10) << longest << std::setw(12) << map.bucket_count()
+              << (found == ROUNDS * queries.size() && map.size() == keys.size() ? "" : "  WRONG RESULTS") << std::defaultfloat << std::endl;
+}
+
+// Nanoseconds per reduction of random hashes for a mid-size table, each index feeding the
+// next hash so the latency is measured rather than the throughput
+template <typename Index>
+static double reduction_ns(const std::vector<uint64_t> & hashes)
+{
+    Index index(Index::round_bucket_count(1000000));
+    size_t bucket = 0;
+    double ms = time_ms([&] {
+        for (uint64_t hash : hashes)
+            {bucket = index(hash ^ bucket);}
+    });
+    benchmark_sink = bucket;
+    return ms * 1e6 / hashes.size();
+}
+
+static void bench_bucket_index()
+{
+    std::mt19937_64 generator(47);
+    std::vector<uint64_t> hashes = random_keys(10000000, generator);
+    std::cout << "ns per bucket index: hash % prime " << reduction_ns<PlainModulo>(hashes)
+              << ", PrimeModulo " << reduction_ns<PrimeModulo>(hashes) << ", FastRange " << reduction_ns<FastRange>(hashes)
+              << ", PowerOfTwoMask " << reduction_ns<PowerOfTwoMask>(hashes) << std::endl << std::endl;
+
+    struct HashCase {
+        const char * name;
+        HashType type;
+        size_t n;       // A constant hash makes one chain, so it gets far fewer keys
+    };
+    const HashCase CASES[] = {
+        {"zero", HashType::ZERO, 2000},
+        {"first character", HashType::FIRST_CHARACTER, 20000},
+        {"polynomial rolling", HashType::POLYNOMIAL_ROLLING, 20000},
+        {"fnv1a", HashType::FNV1A, 20000},
+        {"fnv1a", HashType::FNV1A, 1000000},
+    };
+
+    for (const HashCase & hash_case : CASES)
+    {
+        // Words repeat sometimes, dedup so every key is inserted once
+        std::vector<std::string> keys = random_words(hash_case.n, generator);
+        std::sort(keys.begin(), keys.end());
+        keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+        std::vector<std::string> queries = keys;
+        std::shuffle(queries.begin(), queries.end(), generator);
+
+        std::cout << hash_case.name << " hash, " << keys.size() << " string keys, Mops/s" << std::endl;
+        std::cout << std::setw(20) << "bucket index" << std::setw(10) << "insert" << std::setw(10) << "hit"
+                  << std::setw(10) << "longest" << std::setw(12) << "buckets" << std::endl;
+        bench_bucket_index_policy<PlainModulo>("hash % prime", hash_case.type, keys, queries);
+        bench_bucket_index_policy<PrimeModulo>("PrimeModulo", hash_case.type, keys, queries);
+        bench_bucket_index_policy<FastRange>("FastRange", hash_case.type, keys, queries);
+        bench_bucket_index_policy<PowerOfTwoMask>("PowerOfTwoMask", hash_case.type, keys, queries);
+    }
+}
+
+// Hashes every call it gets, to show how many times each operation hashes a key
+struct counting_fnv1a_hash {
+    size_t * calls;
+
+    size_t operator() (std::string const & str) const
+    {
+        ++*calls;
+        return fnv1a_hash{}(str);
+    }
+};
+
+static void bench_string_traversal()
+{
+    constexpr size_t N = 1000000;
+
+    std::mt19937_64 generator(53);
+    std::vector<std::string> keys = random_words(N, generator);
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    size_t n = keys.size();
+    std::vector<std::string> victims = keys;
+    std::shuffle(victims.begin(), victims.end(), generator);
+
+    size_t calls = 0;
+    UnorderedMap<std::string, size_t, counting_fnv1a_hash> map(30, counting_fnv1a_hash{&calls});
+    for (size_t i = 0; i < n; i++)
+        {map.insert({keys[i], i});}
+
+    std::cout << n << " string keys, fnv1a" << std::endl;
+    std::cout << std::setw(22) << "operation" << std::setw(12) << "Mops/s" << std::setw(16) << "hashes / op" << std::endl;
+    auto report = [&](const char * name, size_t operations, double ms, size_t hashes) {
+        std::cout << std::setw(22) << name << std::fixed << std::setprecision(2) << std::setw(12) << mops(operations, ms)
+                  << std::setw(16) << static_cast<double>(hashes) / operations << std::defaultfloat << std::endl;
+    };
+
+    size_t sum = 0;
+    calls = 0;
+    double iterate_ms = time_ms([&] {
+        for (auto it = map.begin(); it != map.end(); ++it)
+            {sum += it -> second;}
+    });
+    report("iterate", n, iterate_ms, calls);
+
+    // Erase half by key in random order, then the rest while traversing
+    calls = 0;
+    double erase_key_ms = time_ms([&] {
+        for (size_t i = 0; i < n / 2; i++)
+            {map.erase(victims[i]);}
+    });
+    report("erase(key)", n / 2, erase_key_ms, calls);
+
+    size_t left = map.size();
+    calls = 0;
+    double erase_iterator_ms = time_ms([&] {
+        for (auto it = map.begin(); it != map.end(); )
+            {it = map.erase(it);}
+    });
+    report("erase(iterator)", left, erase_iterator_ms, calls);
+
+    benchmark_sink = sum;
+    if (!map.empty())
+        {std::cout << "WRONG RESULTS" << std::endl;}
+}
+
+// Keys arrive as views into one receive buffer, longer than the small string buffer of std::string
+static void bench_transparent_lookup()
+{
+    constexpr size_t N = 200000;
+    constexpr size_t ROUNDS = 5;
+
+    std::mt19937_64 generator(59);
+    std::string buffer;
+    for (size_t i = 0; i < N; i++)
+        {buffer += "session:" + std::to_string(generator()) + "\n";}
+
+    std::vector<std::string_view> views;
+    for (size_t start = 0; start < buffer.size(); )
+    {
+        size_t end = buffer.find('\n', start);
+        views.push_back(std::string_view(buffer).substr(start, end - start));
+        start = end + 1;
+    }
+
+    UnorderedMap<std::string, size_t, fnv1a_hash, std::equal_to<>> map(30);
+    for (size_t i = 0; i < views.size(); i++)
+        {map.insert({std::string(views[i]), i});}
+    std::shuffle(views.begin(), views.end(), generator);
+
+    std::cout << views.size() << " lookups of std::string keys from string_views, " << ROUNDS << " rounds" << std::endl;
+    std::cout << std::setw(28) << "lookup" << std::setw(10) << "Mops/s" << std::setw(16) << "allocs / find" << std::endl;
+
+    auto run = [&](const char * name, auto && find) {
+        size_t found = 0;
+        size_t allocations = allocation_count;
+        double ms = time_ms([&] {
+            for (size_t round = 0; round < ROUNDS; round++)
+            {
+                for (std::string_view view : views)
+                    {found += find(view);}
+            }
+        });
+        allocations = allocation_count - allocations;
+
+        size_t lookups = ROUNDS * views.size();
+        std::cout << std::setw(28) << name << std::fixed << std::setprecision(2) << std::setw(10) << mops(lookups, ms)
+                  << std::setw(16) << static_cast<double>(allocations) / lookups
+                  << (found == lookups ? "" : "  MISSING KEYS") << std::defaultfloat << std::endl;
+    };
+
+    run("find(std::string(view))", [&](std::string_view view) {return map.find(std::string(view)) != map.end();});
+    run("find(view)", [&](std::string_view view) {return map.find(view) != map.end();});
+}
+
+// Mapped values big enough that building a temporary and copying it shows
+using LargeValue = std::array<uint64_t, 32>;
+
+static void bench_emplace()
+{
+    constexpr size_t N = 500000;
+
+    std::mt19937_64 generator(61);
+    std::vector<uint64_t> keys = random_keys(N, generator);
+    LargeValue value {};
+    value[0] = 1;
+
+    std::cout << N << " uint64 keys with " << sizeof(LargeValue) << " byte values, Mops/s" << std::endl;
+    auto report = [&](const char * name, double ms, bool ok) {
+        std::cout << std::setw(34) << name << std::fixed << std::setprecision(2) << std::setw(10) << mops(N, ms)
+                  << (ok ? "" : "  WRONG RESULTS") << std::defaultfloat << std::endl;
+    };
+
+    UnorderedMap<uint64_t, LargeValue> map(30);
+    map.reserve(N);
+    double ms = time_ms([&] {
+        for (uint64_t key : keys)
+            {map[key][0] = key;}
+    });
+    report("operator[] new keys", ms, map.size() == N);
+
+    map.clear();
+    ms = time_ms([&] {
+        for (uint64_t key : keys)
+            {map.insert({key, value});}
+    });
+    report("insert({key, value}) new keys", ms, map.size() == N);
+
+    map.clear();
+    ms = time_ms([&] {
+        for (uint64_t key : keys)
+            {map.try_emplace(key, value);}
+    });
+    report("try_emplace(key, value) new keys", ms, map.size() == N);
+
+    ms = time_ms([&] {
+        for (uint64_t key : keys)
+            {map.insert({key, value});}
+    });
+    report("insert({key, value}) existing", ms, map.size() == N);
+
+    ms = time_ms([&] {
+        for (uint64_t key : keys)
+            {map.try_emplace(key, value);}
+    });
+    report("try_emplace(key, value) existing", ms, map.size() == N);
+
+    ms = time_ms([&] {
+        for (uint64_t key : keys)
+            {map.insert_or_assign(key, value);}
+    });
+    report("insert_or_assign existing", ms, map.size() == N);
+}
+
+// The alternative to sharding: one UnorderedMap behind one mutex
+class GloballyLockedMap {
+    std::mutex _lock;
+    UnorderedMap<uint64_t, uint64_t> _map {0};
+
+public:
+    bool find(uint64_t key)
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        return _map.contains(key);
+    }
+
+    void upsert(uint64_t key, uint64_t value)
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        _map.insert_or_assign(key, value);
+    }
+};
+
+class ShardedMap {
+    ConcurrentUnorderedMap<uint64_t, uint64_t> _map;
+
+public:
+    bool find(uint64_t key) {return _map.contains(key);}
+
+    void upsert(uint64_t key, uint64_t value) {_map.upsert(key, [value](uint64_t & v) {v = value;}, value);}
+};
+
+// Total Mops/s of threads running read_percent% finds and the rest upserts over keys
+template <typename Map>
+static double concurrent_mix(Map & map, const std::vector<uint64_t> & keys, size_t threads, size_t read_percent)
+{
+    constexpr size_t OPERATIONS = 2000000;
+
+    std::vector<std::thread> workers;
+    double ms = time_ms([&] {
+        for (size_t t = 0; t < threads; t++)
+        {
+            workers.emplace_back([&, t] {
+                std::mt19937_64 generator(t);
+                size_t found = 0;
+                for (size_t i = 0; i < OPERATIONS / threads; i++)
+                {
+                    uint64_t random = generator();
+                    uint64_t key = keys[random % keys.size()];
+                    if ((random >> 40) % 100 < read_percent)
+                        {found += map.find(key);}
+                    else
+                        {map.upsert(key, random);}
+                }
+                benchmark_sink = found;
+            });
+        }
+        for (std::thread & worker : workers)
+            {worker.join();}
+    });
+    return mops(OPERATIONS / threads * threads, ms);
+}
+
+static void bench_concurrent()
+{
+    constexpr size_t THREADS[] = {1, 2, 4, 8, 32};
+    constexpr size_t KEYS = 1000000;
+
+    std::mt19937_64 generator(67);
+    std::vector<uint64_t> keys = random_keys(KEYS, generator);
+
+    std::cout << "Concurrent finds / upserts over " << KEYS << " uint64 keys, total Mops/s, "
+              << std::thread::hardware_concurrency() << " hardware threads" << std::endl;
+    std::cout << std::setw(8) << "threads" << std::setw(16) << "global 95/5" << std::setw(16) << "sharded 95/5"
+              << std::setw(16) << "global 50/50" << std::setw(16) << "sharded 50/50" << std::endl;
+
+    for (size_t threads : THREADS)
+    {
+        std::cout << std::setw(8) << threads << std::fixed << std::setprecision(2);
+        for (size_t read_percent : {95, 50})
+        {
+            GloballyLockedMap global;
+            ShardedMap sharded;
+            std::cout << std::setw(16) << concurrent_mix(global, keys, threads, read_percent)
+                      << std::setw(16) << concurrent_mix(sharded, keys, threads, read_percent);
+        }
+        std::cout << std::defaultfloat << std::endl;
+    }
+}
+
+// A read-mostly map guarded the usual way, readers share a reader/writer lock
+class SharedLockedMap {
+    mutable std::shared_mutex _lock;
+    UnorderedMap<uint64_t, uint64_t> _map {0};
+
+public:
+    bool find(uint64_t key) const
+    {
+        std::shared_lock<std::shared_mutex> lock(_lock);
+        return _map.contains(key);
+    }
+
+    template <typename F>
+    void update(F && f)
+    {
+        std::unique_lock<std::shared_mutex> lock(_lock);
+        f(_map);
+    }
+};
+
+class RcuMap {
+    RcuUnorderedMap<uint64_t, uint64_t> _map;
+
+public:
+    bool find(uint64_t key) const {return _map.contains(key);}
+
+    template <typename F>
+    void update(F && f) {_map.update(std::forward<F>(f));}
+};
+
+// Total lookup Mops/s of reader threads while one writer changes a batch of keys every UPDATE_PERIOD
+template <typename Map>
+static double read_mostly(const std::vector<uint64_t> & keys, size_t readers)
+{
+    constexpr size_t LOOKUPS = 4000000;
+    constexpr auto UPDATE_PERIOD = std::chrono::milliseconds(50);
+    constexpr size_t UPDATE_BATCH = 100;
+
+    Map map;
+    map.update([&](auto & m) {
+        for (uint64_t key : keys)
+            {m.insert_or_assign(key, key);}
+    });
+
+    std::atomic<bool> done {false};
+    std::thread writer([&] {
+        std::mt19937_64 generator(1);
+        while (!done.load(std::memory_order_relaxed))
+        {
+            std::this_thread::sleep_for(UPDATE_PERIOD);
+            map.update([&](auto & m) {
+                for (size_t i = 0; i < UPDATE_BATCH; i++)
+                    {m.insert_or_assign(keys[generator() % keys.size()], generator());}
+            });
+        }
+    });
+
+    std::vector<std::thread> workers;
+    double ms = time_ms([&] {
+        for (size_t t = 0; t < readers; t++)
+        {
+            workers.emplace_back([&, t] {
+                std::mt19937_64 generator(t);
+                size_t found = 0;
+                for (size_t i = 0; i < LOOKUPS / readers; i++)
+                    {found += map.find(keys[generator() % keys.size()]);}
+                benchmark_sink = found;
+            });
+        }
+        for (std::thread & worker : workers)
+            {worker.join();}
+    });
+
+    done = true;
+    writer.join();
+    return mops(LOOKUPS / readers * readers, ms);
+}
+
+static void bench_rcu()
+{
+    constexpr size_t KEYS = 100000;
+
+    std::mt19937_64 generator(71);
+    std::vector<uint64_t> keys = random_keys(KEYS, generator);
+
+    size_t cores = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    std::vector<size_t> thread_counts;
+    for (size_t threads = 1; threads < cores; threads *= 2)
+        {thread_counts.push_back(threads);}
+    thread_counts.push_back(cores);
+
+    std::cout << "Read-mostly lookups over " << KEYS << " uint64 keys, one writer updating "
+              << "100 keys every 50 ms, total Mops/s, " << cores << " hardware threads" << std::endl;
+    std::cout << std::setw(8) << "readers" << std::setw(16) << "shared_mutex" << std::setw(16) << "rcu" << std::endl;
+
+    for (size_t threads : thread_counts)
+    {
+        std::cout << std::setw(8) << threads << std::fixed << std::setprecision(2)
+                  << std::setw(16) << read_mostly<SharedLockedMap>(keys, threads)
+                  << std::setw(16) << read_mostly<RcuMap>(keys, threads)
+                  << std::defaultfloat << std::endl;
+    }
+}
+
+static void bench_find_batch()
+{
+    constexpr size_t SIZES[] = {100000, 1000000, 4000000, 16000000};
+    constexpr size_t LOOKUPS = 4000000;
+    constexpr size_t PROBE_BATCH = 256;     // Keys a join hands over at once
+
+    std::mt19937_64 generator(73);
+
+    std::cout << LOOKUPS << " lookups of random present uint64 keys in batches of " << PROBE_BATCH
+              << ", Mops/s" << std::endl;
+    std::cout << std::setw(10) << "keys" << std::setw(12) << "find loop" << std::setw(12) << "find_batch" << std::endl;
+
+    for (size_t size : SIZES)
+    {
+        std::vector<uint64_t> keys = random_keys(size, generator);
+        UnorderedMap<uint64_t, uint64_t> map(0);
+        for (uint64_t key : keys)
+            {map.insert({key, key});}
+
+        // Probe keys in a different order from the inserts, so neighbouring probes hit unrelated nodes
+        std::vector<uint64_t> probes(LOOKUPS);
+        for (uint64_t & probe : probes)
+            {probe = keys[generator() % size];}
+
+        using iterator = UnorderedMap<uint64_t, uint64_t>::iterator;
+        std::vector<iterator> found(PROBE_BATCH);
+
+        size_t loop_sum = 0;
+        double loop_ms = time_ms([&] {
+            for (size_t begin = 0; begin < LOOKUPS; begin += PROBE_BATCH)
+            {
+                for (size_t i = 0; i < PROBE_BATCH; i++)
+                    {found[i] = map.find(probes[begin + i]);}
+                for (size_t i = 0; i < PROBE_BATCH; i++)
+                    {loop_sum += found[i] -> second;}
+            }
+        });
+
+        size_t batch_sum = 0;
+        double batch_ms = time_ms([&] {
+            for (size_t begin = 0; begin < LOOKUPS; begin += PROBE_BATCH)
+            {
+                map.find_batch(probes.data() + begin, PROBE_BATCH, found.data());
+                for (size_t i = 0; i < PROBE_BATCH; i++)
+                    {batch_sum += found[i] -> second;}
+            }
+        });
+        benchmark_sink = loop_sum + batch_sum;
+
+        std::cout << std::setw(10) << size << std::fixed << std::setprecision(2)
+                  << std::setw(12) << mops(LOOKUPS, loop_ms) << std::setw(12) << mops(LOOKUPS, batch_ms)
+                  << (loop_sum == batch_sum ? "" : "  MISMATCH") << std::defaultfloat << std::endl;
+    }
+}
+
+// The four hashes of main.cpp on the same words, the weak two pile them into a few buckets
+static void bench_treeify()
+{
+    constexpr size_t N = 20000;
+
+    std::mt19937_64 generator(79);
+    std::vector<std::string> keys = random_words(N, generator);
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    std::shuffle(keys.begin(), keys.end(), generator);
+    std::vector<std::string> missing = random_words(N, generator);
+
+    const std::pair<const char *, HashType> HASHES[] = {
+        {"zero", HashType::ZERO},
+        {"first character", HashType::FIRST_CHARACTER},
+        {"polynomial rolling", HashType::POLYNOMIAL_ROLLING},
+        {"fnv1a", HashType::FNV1A},
+    };
+
+    std::cout << keys.size() << " string keys, Mops/s" << std::endl;
+    std::cout << std::setw(20) << "hash" << std::setw(10) << "insert" << std::setw(10) << "hit"
+              << std::setw(10) << "miss" << std::setw(10) << "erase" << std::endl;
+
+    for (auto [name, type] : HASHES)
+    {
+        UnorderedMap<std::string, size_t, hash_selector> map(30, hash_selector(type));
+        size_t found = 0;
+
+        double insert_ms = time_ms([&] {
+            for (size_t i = 0; i < keys.size(); i++)
+                {map.insert({keys[i], i});}
+        });
+        double hit_ms = time_ms([&] {
+            for (const std::string & key : keys)
+                {found += map.find(key) != map.end();}
+        });
+        double miss_ms = time_ms([&] {
+            for (const std::string & key : missing)
+                {found += map.find(key) != map.end();}
+        });
+        double erase_ms = time_ms([&] {
+            for (const std::string & key : keys)
+                {map.erase(key);}
+        });
+
+        // Some random words are in keys, so found may run a little over
+        std::cout << std::setw(20) << name << std::fixed << std::setprecision(2)
+                  << std::setw(10) << mops(keys.size(), insert_ms) << std::setw(10) << mops(keys.size(), hit_ms)
+                  << std::setw(10) << mops(missing.size(), miss_ms) << std::setw(10) << mops(keys.size(), erase_ms)
+                  << (found >= keys.size() && map.empty() ? "" : "  WRONG RESULTS") << std::defaultfloat << std::endl;
+    }
+}
+
+// Resident set size of this process in MB, from /proc
+static double rss_mb()
+{
+    std::ifstream statm("/proc/self/statm");
+    size_t pages = 0, resident = 0;
+    statm >> pages >> resident;
+    return static_cast<double>(resident) * sysconf(_SC_PAGESIZE) / (1 << 20);
+}
+
+// Run f in a child process, so its time and memory start from the same state as the parent's
+template <typename Function>
+static void in_child(Function && f)
+{
+    std::cout.flush();
+    pid_t child = fork();
+    if (child == 0)
+    {
+        f();
+        std::cout.flush();
+        _exit(0);
+    }
+    waitpid(child, nullptr, 0);
+}
+
+static void bench_mapped()
+{
+    constexpr size_t N = 10000000;
+    constexpr size_t LOOKUPS = 1000000;
+
+    std::mt19937_64 generator(83);
+    std::vector<uint64_t> keys = random_keys(N, generator);
+    std::vector<uint64_t> probes(LOOKUPS);
+    for (uint64_t & probe : probes)
+        {probe = keys[generator() % N];}
+
+    // Built and frozen in a child too, so the parent's heap stays as small for both runs below
+    std::string path = (std::filesystem::temp_directory_path() / "benchmark_frozen_map.bin").string();
+    in_child([&] {
+        UnorderedMap<uint64_t, uint64_t> map(0);
+        for (uint64_t key : keys)
+            {map.insert({key, key ^ 1});}
+        double freeze_ms = time_ms([&] {freeze_map(map, path);});
+        std::cout << "freeze_map of " << N << " uint64 entries took " << std::fixed << std::setprecision(0) << freeze_ms
+                  << " ms, file " << std::filesystem::file_size(path) / (1 << 20) << " MB" << std::defaultfloat << std::endl;
+    });
+
+    // Drop the file from the page cache, so opening it really starts cold
+    int fd = open(path.c_str(), O_RDONLY);
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+
+    std::cout << "Start with " << N << " entries, then " << LOOKUPS << " random lookups, each in a fresh process, "
+              << "the file evicted from the page cache" << std::endl;
+    std::cout << std::setw(24) << "start" << std::setw(12) << "ready ms" << std::setw(14) << "lookups ms"
+              << std::setw(12) << "RSS MB" << std::setw(12) << "allocs" << std::endl;
+
+    auto report = [&](const char * name, double ready_ms, double lookup_ms, double rss, size_t allocations, size_t found) {
+        std::cout << std::setw(24) << name << std::fixed << std::setprecision(1) << std::setw(12) << ready_ms
+                  << std::setw(14) << lookup_ms << std::setw(12) << rss << std::setw(12) << allocations
+                  << (found == LOOKUPS ? "" : "  MISSING KEYS") << std::defaultfloat << std::endl;
+    };
+
+    in_child([&] {
+        double rss = rss_mb();
+        size_t allocations = allocation_count;
+        UnorderedMap<uint64_t, uint64_t> map(0);
+        double ready_ms = time_ms([&] {
+            for (uint64_t key : keys)
+                {map.insert({key, key ^ 1});}
+        });
+        size_t found = 0;
+        double lookup_ms = time_ms([&] {
+            for (uint64_t probe : probes)
+                {found += map.find(probe) -> second == (probe ^ 1);}
+        });
+        report("rebuild with insert", ready_ms, lookup_ms, rss_mb() - rss, allocation_count - allocations, found);
+    });
+
+    in_child([&] {
+        double rss = rss_mb();
+        size_t allocations = allocation_count;
+        std::optional<MappedUnorderedMap<uint64_t, uint64_t>> map;
+        double ready_ms = time_ms([&] {map.emplace(path);});
+        size_t found = 0;
+        double lookup_ms = time_ms([&] {
+            for (uint64_t probe : probes)
+                {found += map -> find(probe) == (probe ^ 1);}
+        });
+        report("MappedUnorderedMap", ready_ms, lookup_ms, rss_mb() - rss, allocation_count - allocations, found);
+    });
+
+    std::filesystem::remove(path);
+}
+
+static void bench_copy()
+{
+    constexpr size_t N = 10000000;
+
+    std::mt19937_64 generator(89);
+    std::vector<std::pair<uint64_t, uint64_t>> entries(N);
+    for (auto & [key, value] : entries)
+    {
+        key = generator();
+        value = key ^ 1;
+    }
+
+    std::cout << N << " uint64 entries, ms" << std::endl;
+    auto report = [&](const char * name, double ms, bool correct) {
+        std::cout << std::setw(28) << name << std::fixed << std::setprecision(0) << std::setw(10) << ms
+                  << (correct ? "" : "  WRONG RESULTS") << std::defaultfloat << std::endl;
+    };
+
+    UnorderedMap<uint64_t, uint64_t> source(0);
+    double ms = time_ms([&] {
+        for (const auto & entry : entries)
+            {source.insert(entry);}
+    });
+    report("insert one by one", ms, source.size() == N);
+
+    {
+        std::optional<UnorderedMap<uint64_t, uint64_t>> built;
+        ms = time_ms([&] {built.emplace(entries.begin(), entries.end());});
+        report("range constructor", ms, built -> size() == N);
+    }
+
+    {
+        std::optional<UnorderedMap<uint64_t, uint64_t>> copy;
+        ms = time_ms([&] {copy.emplace(source);});
+        report("copy constructor", ms, copy -> size() == N && copy -> find(entries[N / 2].first) -> second == entries[N / 2].second);
+
+        UnorderedMap<uint64_t, uint64_t> assigned(0);
+        ms = time_ms([&] {assigned = source;});
+        report("copy assignment", ms, assigned.size() == N);
+    }
+
+    // Copying string keys used to hash and compare every one of them again
+    std::vector<std::string> words = random_words(N / 5, generator);
+    UnorderedMap<std::string, size_t, fnv1a_hash> strings(0);
+    for (size_t i = 0; i < words.size(); i++)
+        {strings.insert({words[i], i});}
+
+    std::optional<UnorderedMap<std::string, size_t, fnv1a_hash>> copy;
+    ms = time_ms([&] {copy.emplace(strings);});
+    std::cout << strings.size() << " string entries, ms" << std::endl;
+    report("copy constructor", ms, copy -> size() == strings.size());
+}
+
+// Trace of n draws from keys, the i-th most popular drawn with probability proportional to 1 / (i + 1)^skew
+static std::vector<uint64_t> zipf_trace(const std::vector<uint64_t> & keys, size_t n, double skew, std::mt19937_64 & generator)
+{
+    std::vector<double> cumulative(keys.size());
+    double total = 0;
+    for (size_t i = 0; i < keys.size(); i++)
+        {cumulative[i] = total += 1 / std::pow(i + 1, skew);}
+
+    std::uniform_real_distribution<double> uniform(0, total);
+    std::vector<uint64_t> trace(n);
+    for (uint64_t & key : trace)
+    {
+        size_t rank = std::upper_bound(cumulative.begin(), cumulative.end(), uniform(generator)) - cumulative.begin();
+        key = keys[std::min(rank, keys.size() - 1)];
+    }
+    return trace;
+}
+
+// The usual hand-written LRU cache, std::list for the order and std::unordered_map for the index
+class StdLRUCache {
+    using Order = std::list<std::pair<uint64_t, uint64_t>>;
+
+    Order _order;
+    std::unordered_map<uint64_t, Order::iterator> _index;
+    size_t _capacity;
+
+public:
+    explicit StdLRUCache(size_t capacity) : _capacity(capacity) { }
+
+    uint64_t * get(uint64_t key)
+    {
+        auto it = _index.find(key);
+        if (it == _index.end())
+            {return nullptr;}
+        _order.splice(_order.begin(), _order, it -> second);
+        return &it -> second -> second;
+    }
+
+    void put(uint64_t key, uint64_t value)
+    {
+        _order.emplace_front(key, value);
+        _index[key] = _order.begin();
+        if (_order.size() > _capacity)
+        {
+            _index.erase(_order.back().first);
+            _order.pop_back();
+        }
+    }
+};
+
+// Mops/s of a read-through cache over trace: get, and put on a miss. Also returns the hit rate.
+template <typename Cache>
+static std::pair<double, double> replay(Cache & cache, const std::vector<uint64_t> & trace)
+{
+    size_t hits = 0;
+    double ms = time_ms([&] {
+        for (uint64_t key : trace)
+        {
+            if (cache.get(key))
+                {hits++;}
+            else
+                {cache.put(key, key);}
+        }
+    });
+    return {mops(trace.size(), ms), double(hits) / trace.size()};
+}
+
+// A single LRUCache behind one mutex
+class LockedLRUCache {
+    std::mutex _lock;
+    LRUCache<uint64_t, uint64_t> _cache;
+
+public:
+    explicit LockedLRUCache(size_t capacity) : _cache(capacity) { }
+
+    std::optional<uint64_t> get(uint64_t key)
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        if (uint64_t * value = _cache.get(key))
+            {return *value;}
+        return std::nullopt;
+    }
+
+    void put(uint64_t key, uint64_t value)
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        _cache.put(key, value);
+    }
+};
+
+// Total Mops/s of threads each replaying its part of trace through one shared cache
+template <typename Cache>
+static double concurrent_replay(Cache & cache, const std::vector<uint64_t> & trace, size_t threads)
+{
+    std::vector<std::thread> workers;
+    size_t part = trace.size() / threads;
+    double ms = time_ms([&] {
+        for (size_t t = 0; t < threads; t++)
+        {
+            workers.emplace_back([&, t] {
+                size_t hits = 0;
+                for (size_t i = t * part; i < (t + 1) * part; i++)
+                {
+                    if (cache.get(trace[i]))
+                        {hits++;}
+                    else
+                        {cache.put(trace[i], trace[i]);}
+                }
+                benchmark_sink = hits;
+            });
+        }
+        for (std::thread & worker : workers)
+            {worker.join();}
+    });
+    return mops(part * threads, ms);
+}
+
+static void bench_lru()
+{
+    constexpr size_t KEYS = 1000000;
+    constexpr size_t TRACE = 10000000;
+    constexpr double SKEWS[] = {0.8, 0.99};
+    constexpr size_t CAPACITY_PERCENT[] = {1, 10};
+    constexpr size_t THREADS[] = {1, 2, 4, 8};
+
+    std::mt19937_64 generator(97);
+    std::vector<uint64_t> keys = random_keys(KEYS, generator);
+
+    std::cout << "Read-through LRU cache over Zipfian traces of " << TRACE << " lookups on " << KEYS
+              << " uint64 keys, Mops/s (hit rate)" << std::endl;
+    std::cout << std::setw(8) << "skew" << std::setw(10) << "capacity" << std::setw(26) << "std::list+unordered_map"
+              << std::setw(22) << "LRUCache" << std::endl;
+
+    std::vector<uint64_t> trace;
+    for (double skew : SKEWS)
+    {
+        trace = zipf_trace(keys, TRACE, skew, generator);
+        for (size_t percent : CAPACITY_PERCENT)
+        {
+            size_t capacity = KEYS * percent / 100;
+            StdLRUCache std_cache(capacity);
+            LRUCache<uint64_t, uint64_t> cache(capacity);
+            auto [std_mops, std_hits] = replay(std_cache, trace);
+            auto [lru_mops, lru_hits] = replay(cache, trace);
+
+            std::cout << std::fixed << std::setprecision(2) << std::setw(8) << skew << std::setw(9) << percent << "%"
+                      << std::setw(18) << std_mops << " (" << std::setw(4) << std::setprecision(0) << std_hits * 100 << "%)"
+                      << std::setw(14) << std::setprecision(2) << lru_mops << " (" << std::setw(4) << std::setprecision(0)
+                      << lru_hits * 100 << "%)" << std::defaultfloat << std::endl;
+        }
+    }
+
+    size_t capacity = KEYS / 10;
+    std::cout << "Concurrent replay of the last trace, capacity " << capacity << ", total Mops/s, "
+              << std::thread::hardware_concurrency() << " hardware threads" << std::endl;
+    std::cout << std::setw(8) << "threads" << std::setw(16) << "one mutex" << std::setw(16) << "sharded" << std::endl;
+    for (size_t threads : THREADS)
+    {
+        LockedLRUCache locked(capacity);
+        ShardedLRUCache<uint64_t, uint64_t> sharded(capacity);
+        std::cout << std::setw(8) << threads << std::fixed << std::setprecision(2)
+                  << std::setw(16) << concurrent_replay(locked, trace, threads)
+                  << std::setw(16) << concurrent_replay(sharded, trace, threads) << std::defaultfloat << std::endl;
+    }
+}
+
+struct Benchmark
+{
+    const char * name;
+    std::function<void()> run;
+};
+
+int main(int argc, char ** argv)
+{
+    const Benchmark benchmarks[] = {
+        {"growth", bench_growth},
+        {"incremental", bench_incremental_rehash},
+        {"flat", bench_flat_map},
+        {"cuckoo", bench_cuckoo_latency},
+        {"alloc", bench_allocators},
+        {"index", bench_bucket_index},
+        {"traverse", bench_string_traversal},
+        {"transparent", bench_transparent_lookup},
+        {"emplace", bench_emplace},
+        {"concurrent", bench_concurrent},
+        {"rcu", bench_rcu},
+        {"batch", bench_find_batch},
+        {"treeify", bench_treeify},
+        {"mapped", bench_mapped},
+        {"copy", bench_copy},
+        {"lru", bench_lru},
+    };
+
+    for (const Benchmark & benchmark : benchmarks)
+    {
+        if (argc > 1 && std::strcmp(argv[1], benchmark.name) != 0)
+        {
+            continue;
+        }
+        benchmark.run();
+        std::cout << std::endl;
+    }
+
+    return 0;
+}
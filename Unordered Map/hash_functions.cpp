@@ -1,16 +1,17 @@
 #include "hash_functions.h"
 
-size_t polynomial_rolling_hash::operator() (std::string const & str) const {
+size_t polynomial_rolling_hash::operator() (std::string_view str) const {
     size_t hash = 0;
     size_t p = 1;
+    size_t base = 19 + 2 * seed;
     for (char i : str){
         hash+= i*p;
-        p =(p*19)%3298534883309ul;
+        p =(p*base)%3298534883309ul;
     }
     return hash;
 }
 
-size_t fnv1a_hash::operator() (std::string const & str) const {
+size_t fnv1a_hash::operator() (std::string_view str) const {
     size_t hash = 0xCBF29CE484222325;
     for (char i : str){
         hash = hash ^ i;
@@ -1,11 +1,82 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 
+// Every hash takes std::string_view, so std::string, string_view and const char * keys hash the same.
+// is_transparent lets UnorderedMap look up std::string keys by the other two without a conversion.
+
+// seed picks the base of the polynomial, 0 is the original base 19.
+// Different seeds give independent enough hashes for tables that need two of them.
 struct polynomial_rolling_hash {
-    size_t operator() (std::string const & str) const;
+    using is_transparent = void;
+
+    size_t seed = 0;
+
+    size_t operator() (std::string_view str) const;
 };
 
 struct fnv1a_hash {
-    size_t operator() (std::string const & str) const;
+    using is_transparent = void;
+
+    size_t operator() (std::string_view str) const;
+};
+
+// Deliberately weak hashes, for comparing bucket distributions against the two above
+struct zero_hash {
+    using is_transparent = void;
+
+    size_t operator() (std::string_view) const {
+        return 0;
+    }
+};
+
+struct first_character_hash  {
+    using is_transparent = void;
+
+    size_t operator() (std::string_view str) const {
+        if(str.length() == 0)
+            return 0ull;
+
+        return str[0];
+    }
+};
+
+// One of the hashes above picked at run time, main.cpp asks which and benchmark.cpp tries all
+enum class HashType {
+    ZERO,
+    FIRST_CHARACTER,
+    POLYNOMIAL_ROLLING,
+    FNV1A
+};
+
+struct hash_selector {
+    zero_hash _zero_hash;
+    first_character_hash _first_char_hash;
+    polynomial_rolling_hash _poly_rolling_hash;
+    fnv1a_hash _fnv1a_hash;
+    HashType _htype;
+
+    public:
+
+    using is_transparent = void;
+
+    hash_selector(HashType htype) 
+        : _htype(htype)
+    {}
+
+    size_t operator() (std::string_view str) const {
+        switch(_htype) {
+            case HashType::ZERO:
+                return _zero_hash(str);
+            case HashType::FIRST_CHARACTER:
+                return _first_char_hash(str);
+            case HashType::POLYNOMIAL_ROLLING:
+                return _poly_rolling_hash(str);
+            case HashType::FNV1A:
+                return _fnv1a_hash(str);
+        }
+
+        return 0;
+    }
 };
@@ -20,57 +20,6 @@ static void print_sep() {
     std::cout << std::endl << std::endl;
 }
 
-struct zero_hash {
-    size_t operator() (std::string const & str) const {
-        return 0;
-    }
-};
-
-struct first_character_hash  {
-    size_t operator() (std::string const & str) const {
-        if(str.length() == 0)
-            return 0ull;
-
-        return str[0];
-    }
-};
-
-enum class HashType {
-    ZERO,
-    FIRST_CHARACTER,
-    POLYNOMIAL_ROLLING,
-    FNV1A
-};
-
-struct hash_selector {
-    zero_hash _zero_hash;
-    first_character_hash _first_char_hash;
-    polynomial_rolling_hash _poly_rolling_hash;
-    fnv1a_hash _fnv1a_hash;
-    HashType _htype;
-
-    public:
-
-    hash_selector(HashType htype) 
-        : _htype(htype)
-    {}
-
-    size_t operator() (std::string const & str) const {
-        switch(_htype) {
-            case HashType::ZERO:
-                return _zero_hash(str);
-            case HashType::FIRST_CHARACTER:
-                return _first_char_hash(str);
-            case HashType::POLYNOMIAL_ROLLING:
-                return _poly_rolling_hash(str);
-            case HashType::FNV1A:
-                return _fnv1a_hash(str);
-        }
-
-        return 0;
-    }
-};
-
 HashType prompt_hash_type() {
     using std::cin, std::cout, std::endl, std::ios;
 
@@ -230,5 +179,12 @@ int main() {
     std::cout << "  Load factor: " << map.load_factor() << std::endl;
     std::cout << "  Load variance: " << load_variance << std::endl;
 
+    UnorderedMapStats stats = map.stats();
+    std::cout << "  Longest chain: " << stats.longest_chain << std::endl;
+    std::cout << "  Empty buckets: " << stats.empty_bucket_ratio * 100 << "%" << std::endl;
+    std::cout << "  Probes per hit: " << stats.observed_hit_probes << " (uniform hash: " << stats.expected_hit_probes << ")" << std::endl;
+    std::cout << "  Probes per miss: " << stats.observed_miss_probes << " (uniform hash: " << stats.expected_miss_probes << ")" << std::endl;
+    std::cout << "  Memory: " << stats.bucket_bytes << " bytes of buckets, " << stats.node_bytes << " bytes of nodes" << std::endl;
+
     return 0;
 }
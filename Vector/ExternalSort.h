@@ -0,0 +1,403 @@
+#ifndef EXTERNAL_SORT_H
+#define EXTERNAL_SORT_H
+
+#include <algorithm>   // std::find, std::min
+#include <chrono>      // std::chrono::steady_clock
+#include <cstddef>     // size_t
+#include <cstdio>      // std::FILE, std::fopen, std::fread, std::fwrite
+#include <filesystem>  // std::filesystem::path
+#include <functional>  // std::less
+#include <random>      // std::random_device
+#include <stdexcept>   // std::runtime_error, std::invalid_argument
+#include <string>      // std::to_string
+#include <type_traits> // std::is_trivially_copyable
+#include <utility>     // std::move
+#include <vector>      // std::vector
+
+#if defined(__unix__)
+#include <fcntl.h>     // posix_fadvise
+#endif
+
+#include "Vector.h"
+#include "Introsort.h"
+#include "../Priority Queue/PriorityQueue.h"
+
+/*
+    External merge sort for files of fixed-size binary records that do not fit in memory.
+
+    Phase 1 (run formation) reads memory_budget bytes worth of records at a time into a Vector,
+    sorts it with introsort and spills it to a temporary run file.
+
+    Phase 2 (merge) does a k-way merge of the runs with a PriorityQueue holding the current head
+    of every run. Each run is read through its own block buffer, the OS is told the access is
+    sequential so it reads ahead, and if there are more runs than buffers fit in the budget the
+    runs are merged in several passes.
+
+    Records are copied byte for byte, so T has to be trivially copyable.
+*/
+
+struct ExternalSortConfig
+{
+    size_t memory_budget = size_t(256) << 20;   // Bytes used for run formation and merge buffers
+    size_t block_size = size_t(1) << 20;        // Bytes per sequential read/write
+    std::filesystem::path temp_dir = std::filesystem::temp_directory_path();
+};
+
+struct ExternalSortStats
+{
+    size_t records = 0;
+    size_t bytes = 0;
+    size_t runs = 0;            // Runs produced by phase 1
+    size_t merge_passes = 0;    // Passes over the data in phase 2
+    double run_seconds = 0;
+    double merge_seconds = 0;
+
+    // Throughput of each phase, counting every merge pass as one read and one write of the data
+    double run_mb_per_second() const {return run_seconds > 0 ? bytes / run_seconds / (1 << 20) : 0;}
+    double merge_mb_per_second() const {return merge_seconds > 0 ? bytes * merge_passes / merge_seconds / (1 << 20) : 0;}
+};
+
+namespace external_sort_detail
+{
+    // Owns a FILE * so every early exit through an exception closes it
+    class File
+    {
+    private:
+        std::FILE * _file;
+        std::filesystem::path _path;
+
+    public:
+        File(const std::filesystem::path & path, const char * mode) : _path{path}
+        {
+            _file = std::fopen(path.c_str(), mode);
+            if (!_file)
+            {
+                throw std::runtime_error("Could not open " + path.string());
+            }
+        }
+
+        File(File && other) noexcept : _file{other._file}, _path{std::move(other._path)}
+        {
+            other._file = nullptr;
+        }
+
+        File(const File &) = delete;
+        File & operator=(const File &) = delete;
+
+        ~File()
+        {
+            if (_file)
+                {std::fclose(_file);}
+        }
+
+        // Tell the kernel to read ahead aggressively, it is only a hint so failures are ignored
+        void advise_sequential()
+        {
+#if defined(__unix__)
+            posix_fadvise(fileno(_file), 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+        }
+
+        size_t read(void * buffer, size_t bytes)
+        {
+            size_t got = std::fread(buffer, 1, bytes, _file);
+            if (got != bytes && std::ferror(_file))
+            {
+                throw std::runtime_error("Read failed on " + _path.string());
+            }
+            return got;
+        }
+
+        void write(const void * buffer, size_t bytes)
+        {
+            if (std::fwrite(buffer, 1, bytes, _file) != bytes)
+            {
+                throw std::runtime_error("Write failed on " + _path.string());
+            }
+        }
+
+        // Flush and close, reporting errors the destructor would swallow
+        void close()
+        {
+            int result = std::fclose(_file);
+            _file = nullptr;
+            if (result != 0)
+            {
+                throw std::runtime_error("Close failed on " + _path.string());
+            }
+        }
+    };
+
+    // Buffered sequential reader over one sorted run
+    template <typename T>
+    class RunReader
+    {
+    private:
+        File _file;
+        Vector<T> _block;
+        size_t _position, _count;
+
+    public:
+        RunReader(const std::filesystem::path & path, size_t block_records)
+            : _file{path, "rb"}, _block(block_records), _position{0}, _count{0}
+        {
+            _file.advise_sequential();
+            refill();
+        }
+
+        bool empty() const {return _position == _count;}
+
+        const T & front() const {return _block[_position];}
+
+        void pop()
+        {
+            if (++_position == _count)
+                {refill();}
+        }
+
+    private:
+        void refill()
+        {
+            size_t bytes = _file.read(&_block[0], _block.size() * sizeof(T));
+            if (bytes % sizeof(T) != 0)
+            {
+                throw std::runtime_error("Run file is not a whole number of records");
+            }
+            _count = bytes / sizeof(T);
+            _position = 0;
+        }
+    };
+
+    // Buffered sequential writer, flushes whole blocks
+    template <typename T>
+    class RunWriter
+    {
+    private:
+        File _file;
+        Vector<T> _block;
+        size_t _count;
+
+    public:
+        RunWriter(const std::filesystem::path & path, size_t block_records)
+            : _file{path, "wb"}, _block(block_records), _count{0} {}
+
+        void push(const T & value)
+        {
+            _block[_count++] = value;
+            if (_count == _block.size())
+                {flush();}
+        }
+
+        void close()
+        {
+            flush();
+            _file.close();
+        }
+
+    private:
+        void flush()
+        {
+            _file.write(&_block[0], _count * sizeof(T));
+            _count = 0;
+        }
+    };
+
+    // Head of one run in the merge heap
+    template <typename T>
+    struct HeapEntry
+    {
+        T value;
+        size_t run;
+    };
+
+    // PriorityQueue is a max heap, so order entries "greater first" to pop the smallest.
+    // Ties go to the lower run index, which keeps the merge stable across runs.
+    template <typename T, typename Comparator>
+    struct HeapEntryGreater
+    {
+        Comparator comp;
+
+        bool operator()(const HeapEntry<T> & a, const HeapEntry<T> & b) const
+        {
+            if (comp(b.value, a.value))
+                {return true;}
+            if (comp(a.value, b.value))
+                {return false;}
+            return a.run > b.run;
+        }
+    };
+
+    // Merge the given runs into output through a heap of run heads
+    template <typename T, typename Comparator>
+    void merge_runs(const std::vector<std::filesystem::path> & runs, const std::filesystem::path & output,
+                    size_t block_records, Comparator & comp)
+    {
+        using Entry = HeapEntry<T>;
+
+        std::vector<RunReader<T>> readers;
+        readers.reserve(runs.size());
+        for (const std::filesystem::path & run : runs)
+        {
+            readers.emplace_back(run, block_records);
+        }
+
+        RunWriter<T> writer(output, block_records);
+        PriorityQueue<Entry, std::vector<Entry>, HeapEntryGreater<T, Comparator>> heap(HeapEntryGreater<T, Comparator>{comp});
+
+        for (size_t i = 0; i < readers.size(); i++)
+        {
+            if (!readers[i].empty())
+            {
+                heap.push(Entry{readers[i].front(), i});
+                readers[i].pop();
+            }
+        }
+
+        while (!heap.empty())
+        {
+            Entry top = heap.top();
+            heap.pop();
+            writer.push(top.value);
+
+            // Refill from the run the smallest element came from
+            RunReader<T> & reader = readers[top.run];
+            if (!reader.empty())
+            {
+                heap.push(Entry{reader.front(), top.run});
+                reader.pop();
+            }
+        }
+
+        writer.close();
+    }
+
+    // Deletes the temporary run files however the sort exits
+    struct TempFiles
+    {
+        std::vector<std::filesystem::path> paths;
+
+        // Delete files already merged into a later run, so a pass never keeps two copies on disk
+        void remove(const std::vector<std::filesystem::path> & done)
+        {
+            std::error_code ignored;
+            for (const std::filesystem::path & path : done)
+            {
+                std::filesystem::remove(path, ignored);
+                paths.erase(std::find(paths.begin(), paths.end(), path));
+            }
+        }
+
+        ~TempFiles()
+        {
+            std::error_code ignored;
+            for (const std::filesystem::path & path : paths)
+                {std::filesystem::remove(path, ignored);}
+        }
+    };
+
+    inline double seconds_since(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+/*
+    Sort the records of type T in input into output, which may be the same file.
+
+    Throws std::invalid_argument when the budget cannot hold at least two merge blocks, and
+    std::runtime_error on any I/O failure. Temporary files are always removed.
+*/
+template <typename T, typename Comparator = std::less<T>>
+ExternalSortStats external_sort(const std::filesystem::path & input, const std::filesystem::path & output,
+                                const ExternalSortConfig & config = ExternalSortConfig{}, Comparator comp = Comparator{})
+{
+    static_assert(std::is_trivially_copyable<T>::value, "external_sort records are copied as raw bytes");
+    using namespace external_sort_detail;
+
+    size_t block_records = std::max<size_t>(1, config.block_size / sizeof(T));
+    size_t run_records = config.memory_budget / sizeof(T);
+
+    // One input block per run plus the output block must fit in the budget
+    size_t fan_in = config.memory_budget / (block_records * sizeof(T));
+    if (fan_in < 3 || run_records < block_records)
+    {
+        throw std::invalid_argument("memory_budget must hold at least three blocks");
+    }
+    fan_in -= 1;
+
+    ExternalSortStats stats;
+    TempFiles temp;
+
+    std::random_device random;
+    std::string tag = std::to_string(random());
+    size_t next_file = 0;
+    auto temp_path = [&]() {
+        std::filesystem::path path = config.temp_dir / ("external_sort_" + tag + "_" + std::to_string(next_file++) + ".run");
+        temp.paths.push_back(path);
+        return path;
+    };
+
+    // Phase 1: fill the budget, sort in memory, spill
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::vector<std::filesystem::path> runs;
+    {
+        File in(input, "rb");
+        in.advise_sequential();
+        Vector<T> buffer(run_records);
+
+        while (true)
+        {
+            size_t bytes = in.read(&buffer[0], run_records * sizeof(T));
+            if (bytes % sizeof(T) != 0)
+            {
+                throw std::runtime_error("Input is not a whole number of records");
+            }
+            size_t count = bytes / sizeof(T);
+            if (count == 0)
+            {
+                break;
+            }
+
+            introsort(buffer.begin(), buffer.begin() + count, comp);
+
+            runs.push_back(temp_path());
+            File run(runs.back(), "wb");
+            run.write(&buffer[0], count * sizeof(T));
+            run.close();
+
+            stats.records += count;
+            if (count < run_records)
+            {
+                break;
+            }
+        }
+    }
+    stats.bytes = stats.records * sizeof(T);
+    stats.runs = runs.size();
+    stats.run_seconds = seconds_since(start);
+
+    // Phase 2: merge fan_in runs at a time until one pass can produce the output
+    start = std::chrono::steady_clock::now();
+    while (runs.size() > fan_in)
+    {
+        std::vector<std::filesystem::path> merged;
+        for (size_t first = 0; first < runs.size(); first += fan_in)
+        {
+            size_t last = std::min(runs.size(), first + fan_in);
+            std::vector<std::filesystem::path> group(runs.begin() + first, runs.begin() + last);
+
+            merged.push_back(temp_path());
+            merge_runs<T>(group, merged.back(), block_records, comp);
+            temp.remove(group);
+        }
+        runs = std::move(merged);
+        stats.merge_passes++;
+    }
+    merge_runs<T>(runs, output, block_records, comp);
+    stats.merge_passes++;
+    stats.merge_seconds = seconds_since(start);
+
+    return stats;
+}
+
+#endif
@@ -0,0 +1,112 @@
+#ifndef INTROSORT_H
+#define INTROSORT_H
+
+#include <algorithm>   // std::make_heap, std::sort_heap
+#include <cstddef>     // size_t, ptrdiff_t
+#include <iterator>    // std::iterator_traits
+#include <utility>     // std::swap
+
+#include "Vector.h"
+#include "SortingNetwork.h"
+
+/*
+    Introspective sort: median-of-three quicksort that falls back to heap sort once the recursion
+    gets deeper than 2 * log2(n), so the worst case stays O(n log(n)).
+
+    Partitions of at most INTROSORT_THRESHOLD elements are finished with the sorting networks from
+    SortingNetwork.h instead of insertion sort, which avoids the branch mispredictions of insertion
+    on random small windows. Not stable.
+*/
+
+constexpr ptrdiff_t INTROSORT_THRESHOLD = 16;
+
+namespace introsort_detail
+{
+    inline size_t depth_limit(ptrdiff_t n)
+    {
+        size_t depth = 0;
+        while (n > 1)
+        {
+            depth++;
+            n >>= 1;
+        }
+        return 2 * depth;
+    }
+
+    // Put the median of first, middle and last at first so it can be the pivot
+    template <typename RandomIter, typename Comparator>
+    void move_median_to_first(RandomIter first, RandomIter a, RandomIter b, RandomIter c, Comparator & comp)
+    {
+        if (comp(*a, *b))
+        {
+            if (comp(*b, *c))
+                {std::swap(*first, *b);}
+            else if (comp(*a, *c))
+                {std::swap(*first, *c);}
+            else
+                {std::swap(*first, *a);}
+        }
+        else if (comp(*a, *c))
+            {std::swap(*first, *a);}
+        else if (comp(*b, *c))
+            {std::swap(*first, *c);}
+        else
+            {std::swap(*first, *b);}
+    }
+
+    // Hoare partition around *pivot, which must not be inside [begin, end)
+    template <typename RandomIter, typename Comparator>
+    RandomIter partition(RandomIter begin, RandomIter end, RandomIter pivot, Comparator & comp)
+    {
+        while (true)
+        {
+            while (comp(*begin, *pivot))
+                {begin++;}
+            end--;
+            while (comp(*pivot, *end))
+                {end--;}
+            if (!(begin < end))
+                {return begin;}
+            std::swap(*begin, *end);
+            begin++;
+        }
+    }
+
+    template <typename RandomIter, typename Comparator>
+    void introsort_loop(RandomIter begin, RandomIter end, size_t depth, Comparator & comp)
+    {
+        while (end - begin > INTROSORT_THRESHOLD)
+        {
+            if (depth == 0)
+            {
+                // Quicksort is degenerating, heap sort the rest of this partition
+                std::make_heap(begin, end, comp);
+                std::sort_heap(begin, end, comp);
+                return;
+            }
+            depth--;
+
+            RandomIter middle = begin + (end - begin) / 2;
+            move_median_to_first(begin, begin + 1, middle, end - 1, comp);
+            RandomIter cut = partition(begin + 1, end, begin, comp);
+
+            // Recurse on the right part, loop on the left one
+            introsort_loop(cut, end, depth, comp);
+            end = cut;
+        }
+
+        small_sort(begin, end, comp);
+    }
+}
+
+template <typename RandomIter, typename Comparator = less_for_iter<RandomIter>>
+void introsort(RandomIter begin, RandomIter end, Comparator comp = Comparator{})
+{
+    if (end - begin < 2)
+    {
+        return;
+    }
+    introsort_detail::introsort_loop(begin, end, introsort_detail::depth_limit(end - begin), comp);
+}
+
+#endif
@@ -0,0 +1,131 @@
+#ifndef KEY_SORT_H
+#define KEY_SORT_H
+
+#include <cstddef>     // size_t
+#include <functional>  // std::less, std::invoke
+#include <iterator>    // std::iterator_traits
+#include <type_traits> // std::decay_t, std::invoke_result_t
+#include <utility>     // std::pair, std::move
+
+#include "Vector.h"
+#include "TimSort.h"
+
+/*
+    Sorts for when comparing elements is the expensive part.
+
+    sort_by_key calls the projection exactly once per element, caches the keys next to their
+    original positions as (key, index) pairs and sorts those, so comp only ever sees the cheap
+    keys. The elements themselves are then moved once each into place by following the cycles
+    of the permutation.
+
+    argsort / argsort_by_key leave the range alone and return the sorting permutation instead,
+    so large elements are never moved at all.
+
+    All of them are stable, ties keep their original order.
+*/
+
+namespace key_sort_detail
+{
+    template <typename RandomIter, typename Projection>
+    using key_for_iter = std::decay_t<std::invoke_result_t<Projection &, typename std::iterator_traits<RandomIter>::reference>>;
+
+    // One projection call per element, paired with the element's position
+    template <typename RandomIter, typename Projection>
+    Vector<std::pair<key_for_iter<RandomIter, Projection>, size_t>> cache_keys(RandomIter begin, RandomIter end, Projection & projection)
+    {
+        size_t n = end - begin;
+        Vector<std::pair<key_for_iter<RandomIter, Projection>, size_t>> keyed(n);
+        for (size_t i = 0; i < n; i++)
+        {
+            keyed[i].first = std::invoke(projection, begin[i]);
+            keyed[i].second = i;
+        }
+        return keyed;
+    }
+
+    // Compare cached pairs on the key only, timsort keeps the index order for ties
+    template <typename Comparator>
+    struct compare_first
+    {
+        Comparator & comp;
+
+        template <typename Pair>
+        bool operator()(const Pair & a, const Pair & b) const {return comp(a.first, b.first);}
+    };
+}
+
+/*
+    Reorder [begin, end) so that begin[i] becomes the element at begin[order[i]], in place.
+    Every element is moved once plus once more per cycle, order is consumed (left as the identity).
+*/
+template <typename RandomIter>
+void apply_permutation(RandomIter begin, Vector<size_t> & order)
+{
+    for (size_t start = 0; start < order.size(); start++)
+    {
+        if (order[start] == start)
+        {
+            continue;
+        }
+
+        auto held = std::move(begin[start]);
+        size_t current = start;
+        while (true)
+        {
+            size_t source = order[current];
+            order[current] = current;
+            if (source == start)
+            {
+                begin[current] = std::move(held);
+                break;
+            }
+            begin[current] = std::move(begin[source]);
+            current = source;
+        }
+    }
+}
+
+// Permutation that stably sorts [begin, end) by comp, without moving any element
+template <typename RandomIter, typename Comparator = less_for_iter<RandomIter>>
+Vector<size_t> argsort(RandomIter begin, RandomIter end, Comparator comp = Comparator{})
+{
+    size_t n = end - begin;
+    Vector<size_t> order(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        order[i] = i;
+    }
+
+    timsort(order.begin(), order.end(), [&](size_t a, size_t b) { return comp(begin[a], begin[b]); });
+    return order;
+}
+
+// Permutation that stably sorts [begin, end) by projection(element), projecting each element once
+template <typename RandomIter, typename Projection, typename Comparator = std::less<>>
+Vector<size_t> argsort_by_key(RandomIter begin, RandomIter end, Projection projection, Comparator comp = Comparator{})
+{
+    auto keyed = key_sort_detail::cache_keys(begin, end, projection);
+    timsort(keyed.begin(), keyed.end(), key_sort_detail::compare_first<Comparator>{comp});
+
+    Vector<size_t> order(keyed.size());
+    for (size_t i = 0; i < keyed.size(); i++)
+    {
+        order[i] = keyed[i].second;
+    }
+    return order;
+}
+
+// Stably sort [begin, end) by projection(element), projecting each element once
+template <typename RandomIter, typename Projection, typename Comparator = std::less<>>
+void sort_by_key(RandomIter begin, RandomIter end, Projection projection, Comparator comp = Comparator{})
+{
+    if (end - begin < 2)
+    {
+        return;
+    }
+
+    Vector<size_t> order = argsort_by_key(begin, end, projection, comp);
+    apply_permutation(begin, order);
+}
+
+#endif
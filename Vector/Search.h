@@ -0,0 +1,167 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <cstddef>     // size_t, ptrdiff_t
+#include <iterator>    // std::iterator_traits
+#include <type_traits> // std::is_arithmetic
+
+#include "Vector.h"
+
+/*
+    Search kernels for sorted ranges, same results as std::lower_bound / std::upper_bound.
+
+    branchless_lower_bound / branchless_upper_bound halve the range the same number of times
+    for every query and turn the comparison into arithmetic on the offset, so the compiler
+    emits a conditional move instead of a branch that mispredicts half of the time.
+
+    lower_bound_batch runs BATCH_SEARCH_WIDTH of those searches in lockstep and prefetches the
+    next probe of each one as soon as it is known, so the cache misses of the whole group
+    overlap instead of being paid one after the other. This is what helps once the range no
+    longer fits in cache.
+
+    interpolation_search guesses the position from the key values, which takes O(log log n)
+    probes on uniformly distributed integers. It gives up after INTERPOLATION_MAX_PROBES guesses
+    and finishes with the branchless search, so skewed data costs at most a few extra probes.
+*/
+
+constexpr size_t BATCH_SEARCH_WIDTH = 16;
+constexpr size_t INTERPOLATION_MAX_PROBES = 8;
+constexpr ptrdiff_t INTERPOLATION_CUTOFF = 64;   // Below this many elements a binary search is cheaper
+
+namespace search_detail
+{
+    template <typename RandomIter>
+    inline void prefetch(RandomIter it)
+    {
+        __builtin_prefetch(&*it);
+    }
+}
+
+// First element of [begin, end) not less than value
+template <typename RandomIter, typename Value, typename Comparator = less_for_iter<RandomIter>>
+RandomIter branchless_lower_bound(RandomIter begin, RandomIter end, const Value & value, Comparator comp = Comparator{})
+{
+    ptrdiff_t len = end - begin;
+    if (len == 0)
+    {
+        return begin;
+    }
+
+    ptrdiff_t offset = 0;
+    while (len > 1)
+    {
+        ptrdiff_t half = len / 2;
+        offset += half * comp(begin[offset + half - 1], value);
+        len -= half;
+    }
+    return begin + offset + comp(begin[offset], value);
+}
+
+// First element of [begin, end) greater than value
+template <typename RandomIter, typename Value, typename Comparator = less_for_iter<RandomIter>>
+RandomIter branchless_upper_bound(RandomIter begin, RandomIter end, const Value & value, Comparator comp = Comparator{})
+{
+    ptrdiff_t len = end - begin;
+    if (len == 0)
+    {
+        return begin;
+    }
+
+    ptrdiff_t offset = 0;
+    while (len > 1)
+    {
+        ptrdiff_t half = len / 2;
+        offset += half * !comp(value, begin[offset + half - 1]);
+        len -= half;
+    }
+    return begin + offset + !comp(value, begin[offset]);
+}
+
+/*
+    lower_bound of every query in [queries, queries_end), written to out as iterators into
+    [begin, end). Queries are processed BATCH_SEARCH_WIDTH at a time.
+*/
+template <typename RandomIter, typename QueryIter, typename OutputIter, typename Comparator = less_for_iter<RandomIter>>
+OutputIter lower_bound_batch(RandomIter begin, RandomIter end, QueryIter queries, QueryIter queries_end,
+                             OutputIter out, Comparator comp = Comparator{})
+{
+    ptrdiff_t n = end - begin;
+    ptrdiff_t offsets[BATCH_SEARCH_WIDTH];
+
+    while (queries != queries_end)
+    {
+        QueryIter group = queries;
+        size_t count = 0;
+        while (count < BATCH_SEARCH_WIDTH && queries != queries_end)
+        {
+            offsets[count++] = 0;
+            ++queries;
+        }
+
+        if (n == 0)
+        {
+            for (size_t i = 0; i < count; i++)
+                {*out++ = begin;}
+            continue;
+        }
+
+        // Every search in the group has the same len at every level, only the offsets differ
+        ptrdiff_t len = n;
+        while (len > 1)
+        {
+            ptrdiff_t half = len / 2;
+            ptrdiff_t next_half = (len - half) / 2;
+            QueryIter query = group;
+            for (size_t i = 0; i < count; i++, ++query)
+            {
+                offsets[i] += half * comp(begin[offsets[i] + half - 1], *query);
+                if (next_half > 0)
+                    {search_detail::prefetch(begin + (offsets[i] + next_half - 1));}
+            }
+            len -= half;
+        }
+
+        QueryIter query = group;
+        for (size_t i = 0; i < count; i++, ++query)
+            {*out++ = begin + offsets[i] + comp(begin[offsets[i]], *query);}
+    }
+    return out;
+}
+
+// lower_bound for arithmetic keys sorted ascending, fastest when they are evenly spread
+template <typename RandomIter>
+RandomIter interpolation_search(RandomIter begin, RandomIter end, const typename std::iterator_traits<RandomIter>::value_type & value)
+{
+    using value_type = typename std::iterator_traits<RandomIter>::value_type;
+    static_assert(std::is_arithmetic<value_type>::value, "interpolation_search needs arithmetic keys");
+
+    // The answer is always in [low, high]
+    ptrdiff_t low = 0;
+    ptrdiff_t high = end - begin;
+    for (size_t probes = 0; probes < INTERPOLATION_MAX_PROBES && high - low > INTERPOLATION_CUTOFF; probes++)
+    {
+        value_type first = begin[low];
+        value_type last = begin[high - 1];
+        if (!(first < value))
+            {return begin + low;}
+        if (last < value)
+            {return begin + high;}
+
+        // first < value <= last, so the fraction is in (0, 1] and the guess in [low, high - 1].
+        // Doubles keep the subtraction from overflowing for wide integer types, but can round
+        // a tiny spread of 64-bit keys to zero, in which case guess the middle.
+        double spread = static_cast<double>(last) - static_cast<double>(first);
+        double fraction = spread > 0 ? (static_cast<double>(value) - static_cast<double>(first)) / spread : 0.5;
+        fraction = fraction > 1 ? 1 : fraction;
+        ptrdiff_t guess = low + static_cast<ptrdiff_t>(fraction * (high - 1 - low));
+        guess = guess < low ? low : (guess > high - 1 ? high - 1 : guess);
+
+        if (begin[guess] < value)
+            {low = guess + 1;}
+        else
+            {high = guess;}
+    }
+    return branchless_lower_bound(begin + low, begin + high, value);
+}
+
+#endif
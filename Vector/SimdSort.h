@@ -0,0 +1,464 @@
+#ifndef SIMD_SORT_H
+#define SIMD_SORT_H
+
+#include <algorithm>   // std::make_heap, std::sort_heap, std::partition
+#include <array>       // std::array
+#include <cmath>       // std::isnan
+#include <cstddef>     // size_t, ptrdiff_t
+#include <cstdint>     // int32_t, uint64_t
+#include <iterator>    // std::iterator_traits
+#include <limits>      // std::numeric_limits
+#include <type_traits> // std::is_same
+#include <utility>     // std::swap
+
+#include "Vector.h"
+#include "Introsort.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define SIMD_SORT_X86 1
+#include <immintrin.h>
+#else
+#define SIMD_SORT_X86 0
+#endif
+
+/*
+    Vectorized quicksort for int32_t, uint64_t and float keys.
+
+    Partitions are done a whole register at a time (compress stores on AVX-512, a permutation
+    lookup table on AVX2) and anything that fits in 8 registers is sorted with bitonic networks
+    entirely inside the registers. The instruction set is picked at runtime, so the binary does
+    not need to be built with -mavx2 / -mavx512f, and other element types or CPUs without AVX2
+    fall back to introsort. Sorts ascending only; NaNs are moved to the end like std::sort would
+    with a NaN-aware comparator. Not stable.
+*/
+
+enum class SimdLevel
+{
+    SCALAR,
+    AVX2,
+    AVX512
+};
+
+// Best instruction set the running CPU supports, detected once
+inline SimdLevel detected_simd_level()
+{
+#if SIMD_SORT_X86
+    static const SimdLevel level = []() {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("popcnt"))
+            {return SimdLevel::AVX512;}
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt"))
+            {return SimdLevel::AVX2;}
+        return SimdLevel::SCALAR;
+    }();
+    return level;
+#else
+    return SimdLevel::SCALAR;
+#endif
+}
+
+template <typename T>
+constexpr bool is_simd_sortable = std::is_same<T, int32_t>::value || std::is_same<T, uint64_t>::value ||
+                                  std::is_same<T, float>::value;
+
+namespace simd_sort_detail
+{
+    constexpr int SMALL_REGISTERS = 8;  // Ranges up to this many registers use the bitonic base case
+
+    inline size_t depth_limit(ptrdiff_t n)
+    {
+        size_t depth = 0;
+        while (n > 1)
+        {
+            depth++;
+            n >>= 1;
+        }
+        return 2 * depth;
+    }
+
+    template <typename T>
+    T median_of_three(T a, T b, T c)
+    {
+        if (a < b)
+            {return b < c ? b : (a < c ? c : a);}
+        return a < c ? a : (b < c ? c : b);
+    }
+
+    // Bit i set when lane i keeps the max in a bitonic stage of block size k comparing lanes i and i ^ j
+    constexpr unsigned take_max_mask(int lanes, int k, int j)
+    {
+        unsigned mask = 0;
+        for (int i = 0; i < lanes; i++)
+        {
+            bool ascending = (i & k) == 0;
+            if ((i > (i ^ j)) == ascending)
+                {mask |= 1u << i;}
+        }
+        return mask;
+    }
+
+    // Lane indices for "lane i takes lane i ^ j", scale > 1 splits each lane into 32-bit halves
+    template <typename Index, int Lanes, int Scale = 1>
+    constexpr std::array<Index, Lanes * Scale> make_xor_lanes(int j)
+    {
+        std::array<Index, Lanes * Scale> indices{};
+        for (int i = 0; i < Lanes; i++)
+        {
+            for (int s = 0; s < Scale; s++)
+                {indices[i * Scale + s] = static_cast<Index>((i ^ j) * Scale + s);}
+        }
+        return indices;
+    }
+
+    template <typename Index, int Lanes, int J>
+    constexpr std::array<Index, Lanes> xor_lanes = make_xor_lanes<Index, Lanes>(J);
+
+    // Immediate for _mm256_permute4x64_epi64 with lane i taking lane i ^ j
+    constexpr int permute4x64_imm(int j)
+    {
+        int imm = 0;
+        for (int i = 0; i < 4; i++)
+            {imm |= (i ^ j) << (2 * i);}
+        return imm;
+    }
+
+    // Widen a 4 lane blend mask to the 8 x 32-bit mask _mm256_blend_epi32 expects
+    constexpr int widen_mask_64(unsigned mask)
+    {
+        int wide = 0;
+        for (int i = 0; i < 4; i++)
+        {
+            if (mask & (1u << i))
+                {wide |= 3 << (2 * i);}
+        }
+        return wide;
+    }
+
+    // For every ">= pivot" lane mask, 32-bit lane indices putting the "< pivot" lanes first.
+    // Scale 2 is for 64-bit lanes permuted as pairs of 32-bit lanes.
+    template <int Lanes, int Scale>
+    constexpr std::array<std::array<int32_t, 8>, (1 << Lanes)> make_compress_table()
+    {
+        std::array<std::array<int32_t, 8>, (1 << Lanes)> table{};
+        for (int mask = 0; mask < (1 << Lanes); mask++)
+        {
+            int out = 0;
+            for (int pass = 0; pass < 2; pass++)
+            {
+                for (int i = 0; i < Lanes; i++)
+                {
+                    if (((mask >> i) & 1) == pass)
+                    {
+                        for (int s = 0; s < Scale; s++)
+                            {table[mask][out++] = i * Scale + s;}
+                    }
+                }
+            }
+        }
+        return table;
+    }
+
+    inline constexpr auto compress_table_32 = make_compress_table<8, 1>();
+    inline constexpr auto compress_table_64 = make_compress_table<4, 2>();
+
+#if SIMD_SORT_X86
+
+#pragma GCC push_options
+#pragma GCC target("avx2,popcnt")
+    namespace avx2
+    {
+        struct Int32Ops
+        {
+            using type = int32_t;
+            using reg = __m256i;
+            static constexpr int lanes = 8;
+            static constexpr type pad = std::numeric_limits<type>::max();
+
+            static reg loadu(const type * p) {return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));}
+            static void storeu(type * p, reg v) {_mm256_storeu_si256(reinterpret_cast<__m256i *>(p), v);}
+            static reg set1(type x) {return _mm256_set1_epi32(x);}
+            static reg min(reg a, reg b) {return _mm256_min_epi32(a, b);}
+            static reg max(reg a, reg b) {return _mm256_max_epi32(a, b);}
+
+            template <int J>
+            static reg shuffle_xor(reg v) {return _mm256_permutevar8x32_epi32(v, loadu(xor_lanes<int32_t, 8, J>.data()));}
+
+            template <unsigned Mask>
+            static reg select(reg a, reg b) {return _mm256_blend_epi32(a, b, Mask);}
+
+            static int partition_vec(type * left, type * right, reg v, reg pivot)
+            {
+                reg less = _mm256_cmpgt_epi32(pivot, v);
+                int mask_ge = ~_mm256_movemask_ps(_mm256_castsi256_ps(less)) & 0xFF;
+                reg packed = _mm256_permutevar8x32_epi32(v, loadu(compress_table_32[mask_ge].data()));
+                storeu(left, packed);
+                storeu(right - lanes, packed);
+                return __builtin_popcount(mask_ge);
+            }
+        };
+
+        struct FloatOps
+        {
+            using type = float;
+            using reg = __m256;
+            static constexpr int lanes = 8;
+            static constexpr type pad = std::numeric_limits<type>::infinity();
+
+            static reg loadu(const type * p) {return _mm256_loadu_ps(p);}
+            static void storeu(type * p, reg v) {_mm256_storeu_ps(p, v);}
+            static reg set1(type x) {return _mm256_set1_ps(x);}
+
+            // Compare and blend instead of min_ps/max_ps, which would turn -0.0 and 0.0 into two 0.0
+            static reg min(reg a, reg b) {return _mm256_blendv_ps(a, b, _mm256_cmp_ps(b, a, _CMP_LT_OQ));}
+            static reg max(reg a, reg b) {return _mm256_blendv_ps(b, a, _mm256_cmp_ps(b, a, _CMP_LT_OQ));}
+
+            template <int J>
+            static reg shuffle_xor(reg v)
+            {
+                __m256i indices = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(xor_lanes<int32_t, 8, J>.data()));
+                return _mm256_permutevar8x32_ps(v, indices);
+            }
+
+            template <unsigned Mask>
+            static reg select(reg a, reg b) {return _mm256_blend_ps(a, b, Mask);}
+
+            static int partition_vec(type * left, type * right, reg v, reg pivot)
+            {
+                int mask_ge = _mm256_movemask_ps(_mm256_cmp_ps(v, pivot, _CMP_GE_OQ));
+                __m256i indices = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(compress_table_32[mask_ge].data()));
+                reg packed = _mm256_permutevar8x32_ps(v, indices);
+                storeu(left, packed);
+                storeu(right - lanes, packed);
+                return __builtin_popcount(mask_ge);
+            }
+        };
+
+        struct UInt64Ops
+        {
+            using type = uint64_t;
+            using reg = __m256i;
+            static constexpr int lanes = 4;
+            static constexpr type pad = std::numeric_limits<type>::max();
+
+            static reg loadu(const type * p) {return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));}
+            static void storeu(type * p, reg v) {_mm256_storeu_si256(reinterpret_cast<__m256i *>(p), v);}
+            static reg set1(type x) {return _mm256_set1_epi64x(static_cast<long long>(x));}
+
+            // AVX2 only has a signed 64-bit compare, flipping the sign bit makes it unsigned
+            static reg greater(reg a, reg b)
+            {
+                reg sign = _mm256_set1_epi64x(std::numeric_limits<long long>::min());
+                return _mm256_cmpgt_epi64(_mm256_xor_si256(a, sign), _mm256_xor_si256(b, sign));
+            }
+            static reg min(reg a, reg b) {return _mm256_blendv_epi8(a, b, greater(a, b));}
+            static reg max(reg a, reg b) {return _mm256_blendv_epi8(b, a, greater(a, b));}
+
+            template <int J>
+            static reg shuffle_xor(reg v) {return _mm256_permute4x64_epi64(v, permute4x64_imm(J));}
+
+            template <unsigned Mask>
+            static reg select(reg a, reg b) {return _mm256_blend_epi32(a, b, widen_mask_64(Mask));}
+
+            static int partition_vec(type * left, type * right, reg v, reg pivot)
+            {
+                reg less = greater(pivot, v);
+                int mask_ge = ~_mm256_movemask_pd(_mm256_castsi256_pd(less)) & 0xF;
+                __m256i indices = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(compress_table_64[mask_ge].data()));
+                reg packed = _mm256_permutevar8x32_epi32(v, indices);
+                storeu(left, packed);
+                storeu(right - lanes, packed);
+                return __builtin_popcount(mask_ge);
+            }
+        };
+
+#include "SimdSortKernel.h"
+    }
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("avx512f,popcnt")
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"   // GCC 12 warns about _mm512_undefined_* inside its own intrinsics
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+    namespace avx512
+    {
+        struct Int32Ops
+        {
+            using type = int32_t;
+            using reg = __m512i;
+            static constexpr int lanes = 16;
+            static constexpr type pad = std::numeric_limits<type>::max();
+
+            static reg loadu(const type * p) {return _mm512_loadu_si512(p);}
+            static void storeu(type * p, reg v) {_mm512_storeu_si512(p, v);}
+            static reg set1(type x) {return _mm512_set1_epi32(x);}
+            static reg min(reg a, reg b) {return _mm512_min_epi32(a, b);}
+            static reg max(reg a, reg b) {return _mm512_max_epi32(a, b);}
+
+            template <int J>
+            static reg shuffle_xor(reg v) {return _mm512_permutexvar_epi32(loadu(xor_lanes<int32_t, 16, J>.data()), v);}
+
+            template <unsigned Mask>
+            static reg select(reg a, reg b) {return _mm512_mask_blend_epi32(static_cast<__mmask16>(Mask), a, b);}
+
+            static int partition_vec(type * left, type * right, reg v, reg pivot)
+            {
+                __mmask16 mask_ge = _mm512_cmpge_epi32_mask(v, pivot);
+                int amount_ge = __builtin_popcount(mask_ge);
+                _mm512_mask_compressstoreu_epi32(left, static_cast<__mmask16>(~mask_ge), v);
+                _mm512_mask_compressstoreu_epi32(right - amount_ge, mask_ge, v);
+                return amount_ge;
+            }
+        };
+
+        struct FloatOps
+        {
+            using type = float;
+            using reg = __m512;
+            static constexpr int lanes = 16;
+            static constexpr type pad = std::numeric_limits<type>::infinity();
+
+            static reg loadu(const type * p) {return _mm512_loadu_ps(p);}
+            static void storeu(type * p, reg v) {_mm512_storeu_ps(p, v);}
+            static reg set1(type x) {return _mm512_set1_ps(x);}
+            static reg min(reg a, reg b) {return _mm512_mask_blend_ps(_mm512_cmp_ps_mask(b, a, _CMP_LT_OQ), a, b);}
+            static reg max(reg a, reg b) {return _mm512_mask_blend_ps(_mm512_cmp_ps_mask(b, a, _CMP_LT_OQ), b, a);}
+
+            template <int J>
+            static reg shuffle_xor(reg v) {return _mm512_permutexvar_ps(_mm512_loadu_si512(xor_lanes<int32_t, 16, J>.data()), v);}
+
+            template <unsigned Mask>
+            static reg select(reg a, reg b) {return _mm512_mask_blend_ps(static_cast<__mmask16>(Mask), a, b);}
+
+            static int partition_vec(type * left, type * right, reg v, reg pivot)
+            {
+                __mmask16 mask_ge = _mm512_cmp_ps_mask(v, pivot, _CMP_GE_OQ);
+                int amount_ge = __builtin_popcount(mask_ge);
+                _mm512_mask_compressstoreu_ps(left, static_cast<__mmask16>(~mask_ge), v);
+                _mm512_mask_compressstoreu_ps(right - amount_ge, mask_ge, v);
+                return amount_ge;
+            }
+        };
+
+        struct UInt64Ops
+        {
+            using type = uint64_t;
+            using reg = __m512i;
+            static constexpr int lanes = 8;
+            static constexpr type pad = std::numeric_limits<type>::max();
+
+            static reg loadu(const type * p) {return _mm512_loadu_si512(p);}
+            static void storeu(type * p, reg v) {_mm512_storeu_si512(p, v);}
+            static reg set1(type x) {return _mm512_set1_epi64(static_cast<long long>(x));}
+            static reg min(reg a, reg b) {return _mm512_min_epu64(a, b);}
+            static reg max(reg a, reg b) {return _mm512_max_epu64(a, b);}
+
+            template <int J>
+            static reg shuffle_xor(reg v) {return _mm512_permutexvar_epi64(_mm512_loadu_si512(xor_lanes<int64_t, 8, J>.data()), v);}
+
+            template <unsigned Mask>
+            static reg select(reg a, reg b) {return _mm512_mask_blend_epi64(static_cast<__mmask8>(Mask), a, b);}
+
+            static int partition_vec(type * left, type * right, reg v, reg pivot)
+            {
+                __mmask8 mask_ge = _mm512_cmpge_epu64_mask(v, pivot);
+                int amount_ge = __builtin_popcount(mask_ge);
+                _mm512_mask_compressstoreu_epi64(left, static_cast<__mmask8>(~mask_ge), v);
+                _mm512_mask_compressstoreu_epi64(right - amount_ge, mask_ge, v);
+                return amount_ge;
+            }
+        };
+
+#include "SimdSortKernel.h"
+    }
+#pragma GCC diagnostic pop
+#pragma GCC pop_options
+
+#endif // SIMD_SORT_X86
+
+    template <typename T>
+    struct ops_for;
+
+#if SIMD_SORT_X86
+    template <>
+    struct ops_for<int32_t>
+    {
+        using avx2 = avx2::Int32Ops;
+        using avx512 = avx512::Int32Ops;
+    };
+
+    template <>
+    struct ops_for<uint64_t>
+    {
+        using avx2 = avx2::UInt64Ops;
+        using avx512 = avx512::UInt64Ops;
+    };
+
+    template <>
+    struct ops_for<float>
+    {
+        using avx2 = avx2::FloatOps;
+        using avx512 = avx512::FloatOps;
+    };
+#endif
+
+    template <typename T>
+    void simd_sort_pointer(T * arr, ptrdiff_t n, SimdLevel level)
+    {
+        if constexpr (std::is_same<T, float>::value)
+        {
+            // NaN compares false both ways and would break partitioning, park them at the end
+            n = std::partition(arr, arr + n, [](float x) { return !std::isnan(x); }) - arr;
+        }
+
+        if (n < 2)
+        {
+            return;
+        }
+
+#if SIMD_SORT_X86
+        if (level == SimdLevel::AVX512)
+        {
+            avx512::quicksort<typename ops_for<T>::avx512>(arr, 0, n, depth_limit(n));
+            return;
+        }
+        if (level == SimdLevel::AVX2)
+        {
+            avx2::quicksort<typename ops_for<T>::avx2>(arr, 0, n, depth_limit(n));
+            return;
+        }
+#endif
+        introsort(arr, arr + n);
+    }
+}
+
+/*
+    Sort [begin, end) ascending with the widest instruction set available, or the one given.
+    Asking for a level the CPU does not support uses the best supported one instead.
+    Element types other than int32_t, uint64_t and float are sorted with introsort.
+*/
+template <typename RandomIter>
+void simd_sort(RandomIter begin, RandomIter end, SimdLevel level = detected_simd_level())
+{
+    using value_type = typename std::iterator_traits<RandomIter>::value_type;
+
+    if constexpr (is_simd_sortable<value_type>)
+    {
+        if (end - begin < 1)
+        {
+            return;
+        }
+        if (static_cast<int>(level) > static_cast<int>(detected_simd_level()))
+        {
+            level = detected_simd_level();
+        }
+        simd_sort_detail::simd_sort_pointer(&*begin, end - begin, level);
+    }
+    else
+    {
+        (void)level;
+        introsort(begin, end);
+    }
+}
+
+#endif
@@ -0,0 +1,247 @@
+// No include guard on purpose: SimdSort.h includes this file once per instruction set, inside a
+// namespace whose functions are compiled for that target and which already declares the Ops
+// structs (Int32Ops, UInt64Ops, FloatOps). Everything here is generic over Ops:
+//
+//     type, reg, lanes, pad          element type, register type, elements per register, +infinity
+//     loadu, storeu, set1, min, max  the usual
+//     shuffle_xor<J>(v)              lane i takes lane i ^ J
+//     select<Mask>(a, b)             lane i takes b where bit i of Mask is set, a otherwise
+//     partition_vec(l, r, v, pivot)  writes lanes < pivot at l and lanes >= pivot ending at r,
+//                                    returns how many are >= pivot. May write a whole register
+//                                    at l and at r - lanes, the caller keeps that much room free.
+
+// One compare-exchange stage of a bitonic network, every lane against lane ^ J
+template <typename Ops, int K, int J>
+inline typename Ops::reg bitonic_step(typename Ops::reg v)
+{
+    typename Ops::reg partner = Ops::template shuffle_xor<J>(v);
+    return Ops::template select<take_max_mask(Ops::lanes, K, J)>(Ops::min(v, partner), Ops::max(v, partner));
+}
+
+// All the stages J = J0, J0 / 2, ..., 1 of block size K
+template <typename Ops, int K, int J>
+inline typename Ops::reg bitonic_stages(typename Ops::reg v)
+{
+    v = bitonic_step<Ops, K, J>(v);
+    if constexpr (J > 1)
+        {return bitonic_stages<Ops, K, J / 2>(v);}
+    else
+        {return v;}
+}
+
+// Full bitonic sort of the lanes of one register
+template <typename Ops, int K = 2>
+inline typename Ops::reg sort_register(typename Ops::reg v)
+{
+    v = bitonic_stages<Ops, K, K / 2>(v);
+    if constexpr (K < Ops::lanes)
+        {return sort_register<Ops, K * 2>(v);}
+    else
+        {return v;}
+}
+
+// Sort a register that already holds a bitonic sequence (the last half of a bitonic merge)
+template <typename Ops>
+inline typename Ops::reg clean_register(typename Ops::reg v)
+{
+    return bitonic_stages<Ops, 2 * Ops::lanes, Ops::lanes / 2>(v);
+}
+
+// Sort NV registers as one sequence of NV * lanes elements: sort each register, then repeatedly
+// bitonic merge neighbouring groups of sorted registers, all without touching memory
+template <typename Ops, int NV>
+inline void sort_registers(typename Ops::reg * v)
+{
+    using reg = typename Ops::reg;
+
+    for (int i = 0; i < NV; i++)
+        {v[i] = sort_register<Ops>(v[i]);}
+
+    for (int size = 1; size < NV; size *= 2)
+    {
+        for (int group = 0; group < NV; group += 2 * size)
+        {
+            // First half against the reversed second half splits the group into two bitonic halves
+            reg merged[NV];
+            for (int i = 0; i < size; i++)
+            {
+                reg a = v[group + i];
+                reg b = Ops::template shuffle_xor<Ops::lanes - 1>(v[group + 2 * size - 1 - i]);
+                merged[i] = Ops::min(a, b);
+                merged[size + i] = Ops::max(a, b);
+            }
+            for (int i = 0; i < 2 * size; i++)
+                {v[group + i] = merged[i];}
+
+            // Half cleaners with strides of whole registers
+            for (int stride = size / 2; stride >= 1; stride /= 2)
+            {
+                for (int block = group; block < group + 2 * size; block += 2 * stride)
+                {
+                    for (int i = block; i < block + stride; i++)
+                    {
+                        reg low = Ops::min(v[i], v[i + stride]);
+                        v[i + stride] = Ops::max(v[i], v[i + stride]);
+                        v[i] = low;
+                    }
+                }
+            }
+
+            // Strides inside a register
+            for (int i = group; i < group + 2 * size; i++)
+                {v[i] = clean_register<Ops>(v[i]);}
+        }
+    }
+}
+
+// Sort up to NV * lanes elements by padding them into registers
+template <typename Ops, int NV>
+void sort_small_block(typename Ops::type * arr, ptrdiff_t n)
+{
+    using type = typename Ops::type;
+    using reg = typename Ops::reg;
+
+    alignas(64) type buffer[NV * Ops::lanes];
+    for (ptrdiff_t i = 0; i < n; i++)
+        {buffer[i] = arr[i];}
+    for (ptrdiff_t i = n; i < NV * Ops::lanes; i++)
+        {buffer[i] = Ops::pad;}
+
+    reg v[NV];
+    for (int i = 0; i < NV; i++)
+        {v[i] = Ops::loadu(buffer + i * Ops::lanes);}
+    sort_registers<Ops, NV>(v);
+    for (int i = 0; i < NV; i++)
+        {Ops::storeu(buffer + i * Ops::lanes, v[i]);}
+
+    for (ptrdiff_t i = 0; i < n; i++)
+        {arr[i] = buffer[i];}
+}
+
+template <typename Ops>
+void sort_small(typename Ops::type * arr, ptrdiff_t n)
+{
+    if (n <= Ops::lanes)
+        {sort_small_block<Ops, 1>(arr, n);}
+    else if (n <= 2 * Ops::lanes)
+        {sort_small_block<Ops, 2>(arr, n);}
+    else if (n <= 4 * Ops::lanes)
+        {sort_small_block<Ops, 4>(arr, n);}
+    else
+        {sort_small_block<Ops, SMALL_REGISTERS>(arr, n);}
+}
+
+/*
+    In-place vectorized partition of [left, right) around pivot, returns the first index >= pivot.
+
+    The first and last registers are held back so there is always a register's worth of free
+    space on both ends, the next register is loaded from whichever end has less free space, and
+    each loaded register is split with partition_vec into the two free areas.
+*/
+template <typename Ops>
+ptrdiff_t partition(typename Ops::type * arr, ptrdiff_t left, ptrdiff_t right, typename Ops::type pivot)
+{
+    using reg = typename Ops::reg;
+    constexpr ptrdiff_t W = Ops::lanes;
+
+    // Scalar pass until the length is a whole number of registers
+    while ((right - left) % W != 0)
+    {
+        if (arr[left] < pivot)
+            {left++;}
+        else
+            {std::swap(arr[left], arr[--right]);}
+    }
+    if (left == right)
+    {
+        return left;
+    }
+
+    reg pivot_vec = Ops::set1(pivot);
+    if (right - left == W)
+    {
+        reg v = Ops::loadu(arr + left);
+        int amount_ge = Ops::partition_vec(arr + left, arr + right, v, pivot_vec);
+        return right - amount_ge;
+    }
+
+    reg first = Ops::loadu(arr + left);
+    reg last = Ops::loadu(arr + right - W);
+    ptrdiff_t l_store = left;
+    ptrdiff_t r_store = right;     // Free space on the right is [right, r_store)
+    left += W;
+    right -= W;
+
+    while (left != right)
+    {
+        reg current;
+        if (r_store - right < left - l_store)
+        {
+            right -= W;
+            current = Ops::loadu(arr + right);
+        }
+        else
+        {
+            current = Ops::loadu(arr + left);
+            left += W;
+        }
+
+        int amount_ge = Ops::partition_vec(arr + l_store, arr + r_store, current, pivot_vec);
+        r_store -= amount_ge;
+        l_store += W - amount_ge;
+    }
+
+    int amount_ge = Ops::partition_vec(arr + l_store, arr + r_store, first, pivot_vec);
+    r_store -= amount_ge;
+    l_store += W - amount_ge;
+
+    amount_ge = Ops::partition_vec(arr + l_store, arr + r_store, last, pivot_vec);
+    l_store += W - amount_ge;
+
+    return l_store;
+}
+
+template <typename Ops>
+void quicksort(typename Ops::type * arr, ptrdiff_t left, ptrdiff_t right, size_t depth)
+{
+    using type = typename Ops::type;
+
+    while (right - left > SMALL_REGISTERS * Ops::lanes)
+    {
+        if (depth == 0)
+        {
+            std::make_heap(arr + left, arr + right);
+            std::sort_heap(arr + left, arr + right);
+            return;
+        }
+        depth--;
+
+        type pivot = median_of_three(arr[left], arr[left + (right - left) / 2], arr[right - 1]);
+        ptrdiff_t cut = partition<Ops>(arr, left, right, pivot);
+
+        if (cut == left)
+        {
+            // Nothing below the pivot, so it is the minimum: gather its copies and drop them
+            for (ptrdiff_t i = left; i < right; i++)
+            {
+                if (!(pivot < arr[i]))
+                    {std::swap(arr[left++], arr[i]);}
+            }
+            continue;
+        }
+
+        // Recurse into the smaller side to bound the stack
+        if (cut - left < right - cut)
+        {
+            quicksort<Ops>(arr, left, cut, depth);
+            left = cut;
+        }
+        else
+        {
+            quicksort<Ops>(arr, cut, right, depth);
+            right = cut;
+        }
+    }
+
+    sort_small<Ops>(arr + left, right - left);
+}
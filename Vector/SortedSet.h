@@ -0,0 +1,369 @@
+#ifndef SORTED_SET_H
+#define SORTED_SET_H
+
+#include <algorithm>   // std::copy
+#include <cstddef>     // size_t, ptrdiff_t
+#include <cstdint>     // int32_t, uint32_t
+#include <iterator>    // std::iterator_traits
+#include <type_traits> // std::is_same, std::is_pointer
+#include <utility>     // std::move
+
+#include "Vector.h"
+#include "TimSort.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/*
+    Kernels over sorted ranges: merge, unique, intersection, union and difference.
+
+    They have the same results as the std:: algorithms of the same name (duplicates are handled
+    as multisets, ties take the element from the first range), but when one range is at least
+    GALLOP_RATIO times longer than the other they walk the short range and gallop through the
+    long one with the exponential search from TimSort.h. That makes them
+    O(m log(n / m)) instead of O(n + m) for very unequal sizes.
+
+    sorted_intersection_unique is for strictly increasing ranges (ID lists). On 32-bit integer
+    keys in contiguous memory with similar sizes it compares blocks of 4 x 4 keys with SSE2.
+*/
+
+constexpr size_t GALLOP_RATIO = 32;
+
+namespace sorted_set_detail
+{
+    // Iterator to the first element of [first, last) not less than value, searching outward from first
+    template <typename Iter, typename Value, typename Comparator>
+    Iter gallop_lower_bound(Iter first, Iter last, const Value & value, Comparator & comp)
+    {
+        ptrdiff_t len = last - first;
+        if (len == 0)
+            {return first;}
+        return first + timsort_detail::gallop_left(value, first, len, 0, comp);
+    }
+
+    // Iterator to the first element of [first, last) greater than value, searching outward from first
+    template <typename Iter, typename Value, typename Comparator>
+    Iter gallop_upper_bound(Iter first, Iter last, const Value & value, Comparator & comp)
+    {
+        ptrdiff_t len = last - first;
+        if (len == 0)
+            {return first;}
+        return first + timsort_detail::gallop_right(value, first, len, 0, comp);
+    }
+
+    template <typename Iter1, typename Iter2>
+    bool is_skewed(Iter1 first1, Iter1 last1, Iter2 first2, Iter2 last2)
+    {
+        size_t n1 = last1 - first1;
+        size_t n2 = last2 - first2;
+        return n1 > n2 * GALLOP_RATIO || n2 > n1 * GALLOP_RATIO;
+    }
+
+    template <typename Iter>
+    constexpr bool is_contiguous = std::is_pointer<Iter>::value ||
+        std::is_same<Iter, typename Vector<typename std::iterator_traits<Iter>::value_type>::iterator>::value;
+
+    template <typename Iter1, typename Iter2>
+    constexpr bool is_simd_intersectable()
+    {
+        using value_type = typename std::iterator_traits<Iter1>::value_type;
+        return (std::is_same<value_type, int32_t>::value || std::is_same<value_type, uint32_t>::value) &&
+               std::is_same<value_type, typename std::iterator_traits<Iter2>::value_type>::value &&
+               is_contiguous<Iter1> && is_contiguous<Iter2>;
+    }
+
+#if defined(__SSE2__)
+    /*
+        Intersection of two strictly increasing arrays of 32-bit keys, 4 x 4 keys at a time.
+        Each block of a is compared against the 4 rotations of the block of b, then whichever
+        block ends with the smaller key (or both) is advanced. Leftovers finish in scalar code.
+    */
+    template <typename T, typename OutputIter>
+    OutputIter intersect_blocks(const T * a, size_t na, const T * b, size_t nb, OutputIter out)
+    {
+        size_t i = 0, j = 0;
+        while (i + 4 <= na && j + 4 <= nb)
+        {
+            __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+            __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + j));
+
+            __m128i equal = _mm_cmpeq_epi32(va, vb);
+            equal = _mm_or_si128(equal, _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(0, 3, 2, 1))));
+            equal = _mm_or_si128(equal, _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(1, 0, 3, 2))));
+            equal = _mm_or_si128(equal, _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(2, 1, 0, 3))));
+
+            int mask = _mm_movemask_ps(_mm_castsi128_ps(equal));
+            while (mask)
+            {
+                int lane = __builtin_ctz(mask);
+                *out++ = a[i + lane];
+                mask &= mask - 1;
+            }
+
+            T a_last = a[i + 3];
+            T b_last = b[j + 3];
+            if (!(b_last < a_last))
+                {i += 4;}
+            if (!(a_last < b_last))
+                {j += 4;}
+        }
+
+        while (i < na && j < nb)
+        {
+            if (a[i] < b[j])
+                {i++;}
+            else if (b[j] < a[i])
+                {j++;}
+            else
+            {
+                *out++ = a[i];
+                i++;
+                j++;
+            }
+        }
+        return out;
+    }
+#endif
+}
+
+// Stable merge of two sorted ranges into out, ties take the first range first
+template <typename Iter1, typename Iter2, typename OutputIter, typename Comparator = less_for_iter<Iter1>>
+OutputIter sorted_merge(Iter1 first1, Iter1 last1, Iter2 first2, Iter2 last2, OutputIter out, Comparator comp = Comparator{})
+{
+    using namespace sorted_set_detail;
+
+    if (is_skewed(first1, last1, first2, last2))
+    {
+        if (last1 - first1 > last2 - first2)
+        {
+            // Copy the stretch of range 1 not greater than each short element, then the element
+            for (; first2 != last2; ++first2)
+            {
+                Iter1 stop = gallop_upper_bound(first1, last1, *first2, comp);
+                out = std::copy(first1, stop, out);
+                first1 = stop;
+                *out++ = *first2;
+            }
+        }
+        else
+        {
+            for (; first1 != last1; ++first1)
+            {
+                Iter2 stop = gallop_lower_bound(first2, last2, *first1, comp);
+                out = std::copy(first2, stop, out);
+                first2 = stop;
+                *out++ = *first1;
+            }
+        }
+    }
+    else
+    {
+        while (first1 != last1 && first2 != last2)
+        {
+            if (comp(*first2, *first1))
+                {*out++ = *first2++;}
+            else
+                {*out++ = *first1++;}
+        }
+    }
+
+    out = std::copy(first1, last1, out);
+    return std::copy(first2, last2, out);
+}
+
+// Remove consecutive equivalent elements of a sorted range, returns the new end.
+// Runs of duplicates are skipped by galloping, so long runs cost O(log(run length)).
+template <typename RandomIter, typename Comparator = less_for_iter<RandomIter>>
+RandomIter sorted_unique(RandomIter first, RandomIter last, Comparator comp = Comparator{})
+{
+    RandomIter write = first;
+    while (first != last)
+    {
+        RandomIter next = first + 1;
+        if (next != last && !comp(*first, *next))
+        {
+            // At least two equal elements, find the end of the run
+            next = sorted_set_detail::gallop_upper_bound(next, last, *first, comp);
+        }
+
+        if (write != first)
+            {*write = std::move(*first);}
+        write++;
+        first = next;
+    }
+    return write;
+}
+
+// Elements of range 1 that are also in range 2 (multiset semantics, like std::set_intersection)
+template <typename Iter1, typename Iter2, typename OutputIter, typename Comparator = less_for_iter<Iter1>>
+OutputIter sorted_intersection(Iter1 first1, Iter1 last1, Iter2 first2, Iter2 last2, OutputIter out, Comparator comp = Comparator{})
+{
+    using namespace sorted_set_detail;
+
+    if (is_skewed(first1, last1, first2, last2))
+    {
+        if (last1 - first1 > last2 - first2)
+        {
+            for (; first2 != last2 && first1 != last1; ++first2)
+            {
+                first1 = gallop_lower_bound(first1, last1, *first2, comp);
+                if (first1 != last1 && !comp(*first2, *first1))
+                    {*out++ = *first1++;}
+            }
+        }
+        else
+        {
+            for (; first1 != last1 && first2 != last2; ++first1)
+            {
+                first2 = gallop_lower_bound(first2, last2, *first1, comp);
+                if (first2 != last2 && !comp(*first1, *first2))
+                {
+                    *out++ = *first1;
+                    ++first2;
+                }
+            }
+        }
+        return out;
+    }
+
+    while (first1 != last1 && first2 != last2)
+    {
+        if (comp(*first1, *first2))
+            {++first1;}
+        else if (comp(*first2, *first1))
+            {++first2;}
+        else
+        {
+            *out++ = *first1++;
+            ++first2;
+        }
+    }
+    return out;
+}
+
+/*
+    Intersection of two strictly increasing ranges (no duplicates inside either one).
+    Gallops when the sizes are skewed, otherwise uses the SSE2 block compare for contiguous
+    int32_t / uint32_t keys with the default ordering, and the plain merge for anything else.
+*/
+template <typename Iter1, typename Iter2, typename OutputIter>
+OutputIter sorted_intersection_unique(Iter1 first1, Iter1 last1, Iter2 first2, Iter2 last2, OutputIter out)
+{
+    using namespace sorted_set_detail;
+
+#if defined(__SSE2__)
+    if constexpr (is_simd_intersectable<Iter1, Iter2>())
+    {
+        if (!is_skewed(first1, last1, first2, last2) && first1 != last1 && first2 != last2)
+        {
+            return intersect_blocks(&*first1, last1 - first1, &*first2, last2 - first2, out);
+        }
+    }
+#endif
+    return sorted_intersection(first1, last1, first2, last2, out);
+}
+
+// Elements in either range, equal pairs written once from range 1 (like std::set_union)
+template <typename Iter1, typename Iter2, typename OutputIter, typename Comparator = less_for_iter<Iter1>>
+OutputIter sorted_union(Iter1 first1, Iter1 last1, Iter2 first2, Iter2 last2, OutputIter out, Comparator comp = Comparator{})
+{
+    using namespace sorted_set_detail;
+
+    if (is_skewed(first1, last1, first2, last2))
+    {
+        if (last1 - first1 > last2 - first2)
+        {
+            for (; first2 != last2; ++first2)
+            {
+                Iter1 stop = gallop_lower_bound(first1, last1, *first2, comp);
+                out = std::copy(first1, stop, out);
+                first1 = stop;
+                if (first1 != last1 && !comp(*first2, *first1))
+                    {*out++ = *first1++;}
+                else
+                    {*out++ = *first2;}
+            }
+        }
+        else
+        {
+            for (; first1 != last1; ++first1)
+            {
+                Iter2 stop = gallop_lower_bound(first2, last2, *first1, comp);
+                out = std::copy(first2, stop, out);
+                first2 = stop;
+                if (first2 != last2 && !comp(*first1, *first2))
+                    {++first2;}
+                *out++ = *first1;
+            }
+        }
+    }
+    else
+    {
+        while (first1 != last1 && first2 != last2)
+        {
+            if (comp(*first1, *first2))
+                {*out++ = *first1++;}
+            else if (comp(*first2, *first1))
+                {*out++ = *first2++;}
+            else
+            {
+                *out++ = *first1++;
+                ++first2;
+            }
+        }
+    }
+
+    out = std::copy(first1, last1, out);
+    return std::copy(first2, last2, out);
+}
+
+// Elements of range 1 not matched by an element of range 2 (like std::set_difference)
+template <typename Iter1, typename Iter2, typename OutputIter, typename Comparator = less_for_iter<Iter1>>
+OutputIter sorted_difference(Iter1 first1, Iter1 last1, Iter2 first2, Iter2 last2, OutputIter out, Comparator comp = Comparator{})
+{
+    using namespace sorted_set_detail;
+
+    if (is_skewed(first1, last1, first2, last2))
+    {
+        if (last1 - first1 > last2 - first2)
+        {
+            // Copy range 1 in bulk between the few elements to remove
+            for (; first2 != last2 && first1 != last1; ++first2)
+            {
+                Iter1 stop = gallop_lower_bound(first1, last1, *first2, comp);
+                out = std::copy(first1, stop, out);
+                first1 = stop;
+                if (first1 != last1 && !comp(*first2, *first1))
+                    {++first1;}
+            }
+        }
+        else
+        {
+            for (; first1 != last1; ++first1)
+            {
+                first2 = gallop_lower_bound(first2, last2, *first1, comp);
+                if (first2 != last2 && !comp(*first1, *first2))
+                    {++first2;}
+                else
+                    {*out++ = *first1;}
+            }
+        }
+        return std::copy(first1, last1, out);
+    }
+
+    while (first1 != last1 && first2 != last2)
+    {
+        if (comp(*first1, *first2))
+            {*out++ = *first1++;}
+        else
+        {
+            if (!comp(*first2, *first1))
+                {++first1;}
+            ++first2;
+        }
+    }
+    return std::copy(first1, last1, out);
+}
+
+#endif
@@ -0,0 +1,149 @@
+#ifndef SORTING_NETWORK_H
+#define SORTING_NETWORK_H
+
+#include <array>       // std::array
+#include <cstddef>     // size_t
+#include <cstdint>     // uint8_t
+#include <iterator>    // std::iterator_traits
+#include <stdexcept>   // std::length_error
+#include <type_traits> // std::is_arithmetic, std::is_pointer
+#include <utility>     // std::index_sequence, std::move, std::swap
+
+#include "Vector.h"
+
+/*
+    Sorting networks for tiny fixed-size ranges (2 to 32 elements).
+
+    The comparator lists are generated at compile time with Batcher's odd-even merge sort, trimmed
+    to N wires. That matches the optimal comparator count up to N = 8 and stays within a handful of
+    comparators of the best known networks above that (e.g. 63 vs 60 for N = 16).
+
+    Every comparator is a compare-exchange with no data dependent branch for arithmetic and pointer
+    types, so the sort of a small window costs the same no matter how the input is ordered.
+*/
+
+constexpr size_t MAX_NETWORK_SIZE = 32;
+
+namespace sorting_network_detail
+{
+    struct Comparator
+    {
+        uint8_t low, high;
+    };
+
+    // Calls visit(i, j) for every comparator of the odd-even merge sort network on n wires
+    template <typename Visitor>
+    constexpr void odd_even_merge_network(size_t n, Visitor && visit)
+    {
+        for (size_t p = 1; p < n; p <<= 1)
+        {
+            for (size_t k = p; k >= 1; k >>= 1)
+            {
+                for (size_t j = k % p; j + k < n; j += 2 * k)
+                {
+                    for (size_t i = 0; i < k && i + j + k < n; i++)
+                    {
+                        // Only compare wires that belong to the same merge block
+                        if ((i + j) / (2 * p) == (i + j + k) / (2 * p))
+                        {
+                            visit(i + j, i + j + k);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    constexpr size_t network_size(size_t n)
+    {
+        size_t count = 0;
+        odd_even_merge_network(n, [&count](size_t, size_t) { count++; });
+        return count;
+    }
+
+    template <size_t N>
+    constexpr std::array<Comparator, network_size(N)> make_network()
+    {
+        std::array<Comparator, network_size(N)> network{};
+        size_t count = 0;
+        odd_even_merge_network(N, [&](size_t i, size_t j) {
+            network[count++] = Comparator{static_cast<uint8_t>(i), static_cast<uint8_t>(j)};
+        });
+        return network;
+    }
+
+    // Branchless for types a conditional move can handle, plain swap for everything else
+    template <typename T>
+    constexpr bool is_branchless = std::is_arithmetic<T>::value || std::is_pointer<T>::value;
+
+    template <typename RandomIter, typename Compare>
+    inline void compare_exchange(RandomIter first, size_t i, size_t j, Compare & comp)
+    {
+        using value_type = typename std::iterator_traits<RandomIter>::value_type;
+
+        if constexpr (is_branchless<value_type>)
+        {
+            value_type a = first[i];
+            value_type b = first[j];
+            bool out_of_order = comp(b, a);
+            first[i] = out_of_order ? b : a;
+            first[j] = out_of_order ? a : b;
+        }
+        else
+        {
+            if (comp(first[j], first[i]))
+            {
+                std::swap(first[i], first[j]);
+            }
+        }
+    }
+
+    template <size_t N, typename RandomIter, typename Compare, size_t... I>
+    inline void apply_network([[maybe_unused]] RandomIter first, Compare & comp, std::index_sequence<I...>)
+    {
+        [[maybe_unused]] constexpr std::array<Comparator, sizeof...(I)> network = make_network<N>();
+        (compare_exchange(first, network[I].low, network[I].high, comp), ...);
+    }
+}
+
+// Number of compare-exchanges in the network used for N elements
+template <size_t N>
+constexpr size_t sorting_network_size = sorting_network_detail::network_size(N);
+
+// Sort exactly N elements starting at first, fully unrolled at compile time
+template <size_t N, typename RandomIter, typename Comparator = less_for_iter<RandomIter>>
+void network_sort(RandomIter first, Comparator comp = Comparator{})
+{
+    static_assert(N <= MAX_NETWORK_SIZE, "Sorting networks are only generated for up to 32 elements");
+    sorting_network_detail::apply_network<N>(first, comp, std::make_index_sequence<sorting_network_size<N>>{});
+}
+
+namespace sorting_network_detail
+{
+    template <typename RandomIter, typename Compare, size_t... N>
+    inline void dispatch(RandomIter first, size_t count, Compare & comp, std::index_sequence<N...>)
+    {
+        // Jump table over the 33 instantiations, sizes 0 and 1 are empty networks
+        using sorter = void (*)(RandomIter, Compare);
+        static constexpr sorter table[] = {&network_sort<N, RandomIter, Compare>...};
+        table[count](first, comp);
+    }
+}
+
+/*
+    Sort a range of at most MAX_NETWORK_SIZE elements with the matching sorting network.
+    Larger ranges are rejected with std::length_error, use introsort() for those.
+*/
+template <typename RandomIter, typename Comparator = less_for_iter<RandomIter>>
+void small_sort(RandomIter begin, RandomIter end, Comparator comp = Comparator{})
+{
+    ptrdiff_t count = end - begin;
+    if (count < 0 || static_cast<size_t>(count) > MAX_NETWORK_SIZE)
+    {
+        throw std::length_error("small_sort supports at most 32 elements");
+    }
+    sorting_network_detail::dispatch(begin, static_cast<size_t>(count), comp,
+                                     std::make_index_sequence<MAX_NETWORK_SIZE + 1>{});
+}
+
+#endif
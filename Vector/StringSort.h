@@ -0,0 +1,202 @@
+#ifndef STRING_SORT_H
+#define STRING_SORT_H
+
+#include <cstddef>     // size_t
+#include <cstdint>     // uint16_t
+#include <string>      // std::string
+#include <string_view> // std::string_view
+#include <type_traits> // std::is_same
+#include <iterator>    // std::iterator_traits
+#include <utility>     // std::swap
+
+#include "Vector.h"
+#include "KeySort.h"
+
+/*
+    Sort for strings that never compares the same prefix twice.
+
+    The strings are sorted through (view, index) pairs, so no character data is copied, and
+    std::string elements are moved into their final place once at the end.
+
+    Large groups use MSD radix sort: one pass reads the character at the current depth of every
+    string into a cache array, then the pairs are counted and distributed into 257 buckets
+    (end of string plus every byte) and each bucket continues one character deeper. Groups
+    smaller than RADIX_THRESHOLD switch to multikey quicksort (3-way partition on a single
+    character), and the smallest to insertion sort on the remaining suffixes.
+
+    The order is plain byte order, the same as std::string's operator<.
+*/
+
+constexpr size_t RADIX_THRESHOLD = 1 << 10;
+constexpr size_t MULTIKEY_THRESHOLD = 16;
+
+namespace string_sort_detail
+{
+    struct StringKey
+    {
+        std::string_view view;
+        size_t index;
+    };
+
+    // Character at depth shifted up by one, 0 meaning the string has ended
+    inline uint16_t char_at(const StringKey & key, size_t depth)
+    {
+        return depth < key.view.size() ? static_cast<unsigned char>(key.view[depth]) + 1 : 0;
+    }
+
+    // Every string in a group shares its first depth characters, so only the rest is compared
+    inline bool suffix_less(const StringKey & a, const StringKey & b, size_t depth)
+    {
+        return a.view.substr(depth) < b.view.substr(depth);
+    }
+
+    inline void insertion_sort(StringKey * keys, size_t n, size_t depth)
+    {
+        for (size_t i = 1; i < n; i++)
+        {
+            StringKey key = keys[i];
+            size_t j = i;
+            while (j > 0 && suffix_less(key, keys[j - 1], depth))
+            {
+                keys[j] = keys[j - 1];
+                j--;
+            }
+            keys[j] = key;
+        }
+    }
+
+    inline uint16_t median_of_three(uint16_t a, uint16_t b, uint16_t c)
+    {
+        if (a < b)
+            {return b < c ? b : (a < c ? c : a);}
+        return a < c ? a : (b < c ? c : b);
+    }
+
+    // Bentley-Sedgewick: split on one character into <, = and >, only = moves one character deeper
+    inline void multikey_quicksort(StringKey * keys, size_t n, size_t depth)
+    {
+        while (n > MULTIKEY_THRESHOLD)
+        {
+            uint16_t pivot = median_of_three(char_at(keys[0], depth), char_at(keys[n / 2], depth), char_at(keys[n - 1], depth));
+
+            // Dijkstra 3-way partition: [0, lt) < pivot, [lt, i) == pivot, [gt, n) > pivot
+            size_t lt = 0, i = 0, gt = n;
+            while (i < gt)
+            {
+                uint16_t c = char_at(keys[i], depth);
+                if (c < pivot)
+                    {std::swap(keys[lt++], keys[i++]);}
+                else if (c > pivot)
+                    {std::swap(keys[i], keys[--gt]);}
+                else
+                    {i++;}
+            }
+
+            multikey_quicksort(keys, lt, depth);
+            multikey_quicksort(keys + gt, n - gt, depth);
+
+            // Strings that ended together are equal, otherwise continue on the next character
+            if (pivot == 0)
+            {
+                return;
+            }
+            keys += lt;
+            n = gt - lt;
+            depth++;
+        }
+        insertion_sort(keys, n, depth);
+    }
+
+    // MSD radix sort of keys[0, n) from depth, temp and cache hold n entries of scratch space
+    inline void msd_radix_sort(StringKey * keys, StringKey * temp, uint16_t * cache, size_t n, size_t depth)
+    {
+        constexpr size_t BUCKETS = 257;
+
+        while (n >= RADIX_THRESHOLD)
+        {
+            size_t counts[BUCKETS] = {};
+            for (size_t i = 0; i < n; i++)
+            {
+                cache[i] = char_at(keys[i], depth);
+                counts[cache[i]]++;
+            }
+
+            // A single bucket (a shared character) needs no distribution, just go deeper
+            if (counts[cache[0]] == n)
+            {
+                if (cache[0] == 0)
+                    {return;}
+                depth++;
+                continue;
+            }
+
+            size_t starts[BUCKETS];
+            size_t sum = 0;
+            for (size_t b = 0; b < BUCKETS; b++)
+            {
+                starts[b] = sum;
+                sum += counts[b];
+            }
+
+            size_t positions[BUCKETS];
+            for (size_t b = 0; b < BUCKETS; b++)
+                {positions[b] = starts[b];}
+            for (size_t i = 0; i < n; i++)
+                {temp[positions[cache[i]]++] = keys[i];}
+            for (size_t i = 0; i < n; i++)
+                {keys[i] = temp[i];}
+
+            // Bucket 0 holds strings that ended, they are all equal and already in place
+            for (size_t b = 1; b < BUCKETS; b++)
+            {
+                if (counts[b] > 1)
+                    {msd_radix_sort(keys + starts[b], temp + starts[b], cache + starts[b], counts[b], depth + 1);}
+            }
+            return;
+        }
+        multikey_quicksort(keys, n, depth);
+    }
+
+    template <typename RandomIter>
+    Vector<size_t> string_argsort(RandomIter begin, RandomIter end)
+    {
+        size_t n = end - begin;
+        Vector<StringKey> keys(n);
+        for (size_t i = 0; i < n; i++)
+        {
+            keys[i].view = std::string_view(begin[i]);
+            keys[i].index = i;
+        }
+
+        if (n > 1)
+        {
+            Vector<StringKey> temp(n >= RADIX_THRESHOLD ? n : 1);
+            Vector<uint16_t> cache(n >= RADIX_THRESHOLD ? n : 1);
+            msd_radix_sort(&keys[0], &temp[0], &cache[0], n, 0);
+        }
+
+        Vector<size_t> order(n);
+        for (size_t i = 0; i < n; i++)
+            {order[i] = keys[i].index;}
+        return order;
+    }
+}
+
+// Sort a range of std::string or std::string_view in byte order without copying character data
+template <typename RandomIter>
+void string_sort(RandomIter begin, RandomIter end)
+{
+    using value_type = typename std::iterator_traits<RandomIter>::value_type;
+    static_assert(std::is_same<value_type, std::string>::value || std::is_same<value_type, std::string_view>::value,
+                  "string_sort sorts std::string or std::string_view");
+
+    if (end - begin < 2)
+    {
+        return;
+    }
+
+    Vector<size_t> order = string_sort_detail::string_argsort(begin, end);
+    apply_permutation(begin, order);
+}
+
+#endif
@@ -0,0 +1,623 @@
+#ifndef TIMSORT_H
+#define TIMSORT_H
+
+#include <algorithm>   // std::move, std::move_backward, std::upper_bound
+#include <cstddef>     // size_t, ptrdiff_t
+#include <iterator>    // std::iterator_traits
+#include <stdexcept>   // std::invalid_argument
+#include <utility>     // std::move
+
+#include "Vector.h"
+
+/*
+    Adaptive, stable merge sort in the style of TimSort.
+
+    The range is scanned for natural runs (non-descending, or strictly descending which get
+    reversed in place so stability is kept). Runs shorter than minrun are extended with binary
+    insertion, pushed on a stack and merged while keeping the stack lengths Fibonacci-like, so
+    an already sorted range costs n - 1 comparisons and a nearly sorted one stays close to O(n).
+
+    Merges copy the shorter run into a scratch Vector and switch into galloping (exponential
+    search) mode whenever one side keeps winning, which is what makes mostly ordered batches cheap.
+
+    O(n log(n)) worst case, O(n) best case, O(n / 2) extra memory.
+*/
+
+// Scratch space for the merges. Keep one around and pass it to timsort() to avoid reallocating
+// the merge buffer on every call when sorting many batches.
+template <typename T>
+class TimSortBuffer
+{
+private:
+    Vector<T> _storage;
+
+public:
+    TimSortBuffer() = default;
+
+    // Make sure at least count elements of scratch space are available, only grows
+    typename Vector<T>::iterator reserve(size_t count)
+    {
+        if (_storage.size() < count)
+        {
+            // Grow geometrically so a slowly increasing batch size does not reallocate each time
+            size_t new_size = std::max(count, _storage.size() * 2);
+            _storage = Vector<T>(new_size);
+        }
+        return _storage.begin();
+    }
+
+    size_t capacity() const noexcept
+    {
+        return _storage.size();
+    }
+};
+
+namespace timsort_detail
+{
+    constexpr ptrdiff_t MIN_MERGE = 32;  // Ranges smaller than this are binary insertion sorted
+    constexpr ptrdiff_t MIN_GALLOP = 7;  // Initial threshold for entering galloping mode
+    constexpr size_t MAX_RUNS = 85;      // Enough pending runs for any 64-bit length
+
+    // Smallest run length such that n / minrun is a power of two or slightly below it
+    inline ptrdiff_t min_run_length(ptrdiff_t n)
+    {
+        ptrdiff_t low_bits = 0;
+        while (n >= MIN_MERGE)
+        {
+            low_bits |= n & 1;
+            n >>= 1;
+        }
+        return n + low_bits;
+    }
+
+    // Sort [begin, end) knowing [begin, start) is already sorted. Upper bound keeps equal keys in order.
+    template <typename RandomIter, typename Comparator>
+    void binary_insertion(RandomIter begin, RandomIter start, RandomIter end, Comparator & comp)
+    {
+        for (RandomIter i = start; i < end; i++)
+        {
+            auto pivot = std::move(*i);
+            RandomIter pos = std::upper_bound(begin, i, pivot, comp);
+            std::move_backward(pos, i, i + 1);
+            *pos = std::move(pivot);
+        }
+    }
+
+    // Length of the run starting at begin, reversing it first if it is strictly descending
+    template <typename RandomIter, typename Comparator>
+    ptrdiff_t count_run_and_make_ascending(RandomIter begin, RandomIter end, Comparator & comp)
+    {
+        RandomIter run_end = begin + 1;
+        if (run_end == end)
+        {
+            return 1;
+        }
+
+        // Strictly descending only, otherwise reversing would swap equal elements
+        if (comp(*run_end, *begin))
+        {
+            run_end++;
+            while (run_end < end && comp(*run_end, *(run_end - 1)))
+            {
+                run_end++;
+            }
+
+            // Not std::reverse, its unqualified swap is ambiguous with ::swap for global types
+            for (RandomIter lo = begin, hi = run_end - 1; lo < hi; lo++, hi--)
+            {
+                std::swap(*lo, *hi);
+            }
+        }
+        else
+        {
+            run_end++;
+            while (run_end < end && !comp(*run_end, *(run_end - 1)))
+            {
+                run_end++;
+            }
+        }
+        return run_end - begin;
+    }
+
+    /*
+        Number of elements in the sorted range [base, base + len) strictly less than key,
+        i.e. the lower bound offset. Starts probing at hint and gallops outward by 1, 3, 7, 15...
+        before finishing with a binary search, so it is O(log(distance from hint)).
+    */
+    template <typename Value, typename Iter, typename Comparator>
+    ptrdiff_t gallop_left(const Value & key, Iter base, ptrdiff_t len, ptrdiff_t hint, Comparator & comp)
+    {
+        ptrdiff_t last_ofs = 0;
+        ptrdiff_t ofs = 1;
+
+        if (comp(base[hint], key))
+        {
+            // Gallop right until base[hint + last_ofs] < key <= base[hint + ofs]
+            ptrdiff_t max_ofs = len - hint;
+            while (ofs < max_ofs && comp(base[hint + ofs], key))
+            {
+                last_ofs = ofs;
+                ofs = (ofs << 1) + 1;
+            }
+            ofs = std::min(ofs, max_ofs);
+            last_ofs += hint;
+            ofs += hint;
+        }
+        else
+        {
+            // Gallop left until base[hint - ofs] < key <= base[hint - last_ofs]
+            ptrdiff_t max_ofs = hint + 1;
+            while (ofs < max_ofs && !comp(base[hint - ofs], key))
+            {
+                last_ofs = ofs;
+                ofs = (ofs << 1) + 1;
+            }
+            ofs = std::min(ofs, max_ofs);
+            ptrdiff_t tmp = last_ofs;
+            last_ofs = hint - ofs;
+            ofs = hint - tmp;
+        }
+
+        // Now base[last_ofs] < key <= base[ofs], binary search the gap
+        last_ofs++;
+        while (last_ofs < ofs)
+        {
+            ptrdiff_t mid = last_ofs + ((ofs - last_ofs) >> 1);
+            if (comp(base[mid], key))
+                {last_ofs = mid + 1;}
+            else
+                {ofs = mid;}
+        }
+        return ofs;
+    }
+
+    // Like gallop_left but returns the upper bound offset (number of elements <= key)
+    template <typename Value, typename Iter, typename Comparator>
+    ptrdiff_t gallop_right(const Value & key, Iter base, ptrdiff_t len, ptrdiff_t hint, Comparator & comp)
+    {
+        ptrdiff_t last_ofs = 0;
+        ptrdiff_t ofs = 1;
+
+        if (comp(key, base[hint]))
+        {
+            // Gallop left until base[hint - ofs] <= key < base[hint - last_ofs]
+            ptrdiff_t max_ofs = hint + 1;
+            while (ofs < max_ofs && comp(key, base[hint - ofs]))
+            {
+                last_ofs = ofs;
+                ofs = (ofs << 1) + 1;
+            }
+            ofs = std::min(ofs, max_ofs);
+            ptrdiff_t tmp = last_ofs;
+            last_ofs = hint - ofs;
+            ofs = hint - tmp;
+        }
+        else
+        {
+            // Gallop right until base[hint + last_ofs] <= key < base[hint + ofs]
+            ptrdiff_t max_ofs = len - hint;
+            while (ofs < max_ofs && !comp(key, base[hint + ofs]))
+            {
+                last_ofs = ofs;
+                ofs = (ofs << 1) + 1;
+            }
+            ofs = std::min(ofs, max_ofs);
+            last_ofs += hint;
+            ofs += hint;
+        }
+
+        last_ofs++;
+        while (last_ofs < ofs)
+        {
+            ptrdiff_t mid = last_ofs + ((ofs - last_ofs) >> 1);
+            if (comp(key, base[mid]))
+                {ofs = mid;}
+            else
+                {last_ofs = mid + 1;}
+        }
+        return ofs;
+    }
+
+    // Holds the pending run stack and the galloping threshold for a single timsort() call
+    template <typename RandomIter, typename Comparator>
+    class TimSorter
+    {
+    public:
+        using value_type = typename std::iterator_traits<RandomIter>::value_type;
+        using buffer_iter = typename Vector<value_type>::iterator;
+
+    private:
+        struct Run
+        {
+            RandomIter base;
+            ptrdiff_t len;
+        };
+
+        Comparator & comp;
+        TimSortBuffer<value_type> & buffer;
+        ptrdiff_t min_gallop;
+
+        Run runs[MAX_RUNS];
+        size_t n_runs;
+
+    public:
+        TimSorter(Comparator & comp, TimSortBuffer<value_type> & buffer)
+            : comp{comp}, buffer{buffer}, min_gallop{MIN_GALLOP}, n_runs{0} {}
+
+        void push_run(RandomIter base, ptrdiff_t len)
+        {
+            runs[n_runs++] = Run{base, len};
+        }
+
+        /*
+            Merge until the stack invariants hold again:
+                runs[i - 2].len > runs[i - 1].len + runs[i].len
+                runs[i - 1].len > runs[i].len
+            Also checks one level deeper than the original paper, which could leave a broken invariant.
+        */
+        void merge_collapse()
+        {
+            while (n_runs > 1)
+            {
+                size_t n = n_runs - 2;
+                if ((n >= 1 && runs[n - 1].len <= runs[n].len + runs[n + 1].len) ||
+                    (n >= 2 && runs[n - 2].len <= runs[n - 1].len + runs[n].len))
+                {
+                    if (runs[n - 1].len < runs[n + 1].len)
+                        {n--;}
+                }
+                else if (runs[n].len > runs[n + 1].len)
+                {
+                    break;
+                }
+                merge_at(n);
+            }
+        }
+
+        // Merge everything that is left, called once the whole range has been scanned
+        void merge_force_collapse()
+        {
+            while (n_runs > 1)
+            {
+                size_t n = n_runs - 2;
+                if (n > 0 && runs[n - 1].len < runs[n + 1].len)
+                    {n--;}
+                merge_at(n);
+            }
+        }
+
+    private:
+        // Merge runs[i] and runs[i + 1], which must be adjacent in the range
+        void merge_at(size_t i)
+        {
+            RandomIter base1 = runs[i].base;
+            ptrdiff_t len1 = runs[i].len;
+            RandomIter base2 = runs[i + 1].base;
+            ptrdiff_t len2 = runs[i + 1].len;
+
+            runs[i].len = len1 + len2;
+            if (i + 3 == n_runs)
+            {
+                runs[i + 1] = runs[i + 2];
+            }
+            n_runs--;
+
+            // Elements of run1 already <= run2[0] are in place
+            ptrdiff_t k = gallop_right(*base2, base1, len1, 0, comp);
+            base1 += k;
+            len1 -= k;
+            if (len1 == 0)
+            {
+                return;
+            }
+
+            // Elements of run2 already >= run1[last] are in place
+            len2 = gallop_left(*(base1 + (len1 - 1)), base2, len2, len2 - 1, comp);
+            if (len2 == 0)
+            {
+                return;
+            }
+
+            // Copy whichever run is shorter into the buffer
+            if (len1 <= len2)
+                {merge_lo(base1, len1, base2, len2);}
+            else
+                {merge_hi(base1, len1, base2, len2);}
+        }
+
+        // Merge left to right with run1 in the buffer. Requires run1[0] > run2[0] and run1[last] > run2[last].
+        void merge_lo(RandomIter base1, ptrdiff_t len1, RandomIter base2, ptrdiff_t len2)
+        {
+            buffer_iter tmp = buffer.reserve(len1);
+            std::move(base1, base1 + len1, tmp);
+
+            buffer_iter cursor1 = tmp;
+            RandomIter cursor2 = base2;
+            RandomIter dest = base1;
+
+            *dest++ = std::move(*cursor2++);
+            if (--len2 == 0)
+            {
+                std::move(cursor1, cursor1 + len1, dest);
+                return;
+            }
+            if (len1 == 1)
+            {
+                dest = std::move(cursor2, cursor2 + len2, dest);
+                *dest = std::move(*cursor1);
+                return;
+            }
+
+            bool done = false;
+            while (!done)
+            {
+                ptrdiff_t count1 = 0;   // Number of times in a row run1 won
+                ptrdiff_t count2 = 0;   // Number of times in a row run2 won
+
+                // Straight one at a time merge until one run starts winning consistently
+                while ((count1 | count2) < min_gallop)
+                {
+                    if (comp(*cursor2, *cursor1))
+                    {
+                        *dest++ = std::move(*cursor2++);
+                        count2++;
+                        count1 = 0;
+                        if (--len2 == 0)
+                            {done = true; break;}
+                    }
+                    else
+                    {
+                        *dest++ = std::move(*cursor1++);
+                        count1++;
+                        count2 = 0;
+                        if (--len1 == 1)
+                            {done = true; break;}
+                    }
+                }
+                if (done)
+                {
+                    break;
+                }
+
+                // Galloping mode, keep going while it pays off
+                do
+                {
+                    count1 = gallop_right(*cursor2, cursor1, len1, 0, comp);
+                    if (count1 != 0)
+                    {
+                        dest = std::move(cursor1, cursor1 + count1, dest);
+                        cursor1 += count1;
+                        len1 -= count1;
+                        if (len1 <= 1)
+                            {done = true; break;}
+                    }
+                    *dest++ = std::move(*cursor2++);
+                    if (--len2 == 0)
+                        {done = true; break;}
+
+                    count2 = gallop_left(*cursor1, cursor2, len2, 0, comp);
+                    if (count2 != 0)
+                    {
+                        dest = std::move(cursor2, cursor2 + count2, dest);
+                        cursor2 += count2;
+                        len2 -= count2;
+                        if (len2 == 0)
+                            {done = true; break;}
+                    }
+                    *dest++ = std::move(*cursor1++);
+                    if (--len1 == 1)
+                        {done = true; break;}
+
+                    min_gallop--;
+                } while (count1 >= MIN_GALLOP || count2 >= MIN_GALLOP);
+
+                if (done)
+                {
+                    break;
+                }
+
+                // Penalize leaving galloping mode
+                if (min_gallop < 0)
+                    {min_gallop = 0;}
+                min_gallop += 2;
+            }
+
+            if (min_gallop < 1)
+                {min_gallop = 1;}
+
+            if (len1 == 1)
+            {
+                // Last element of run1 is greater than everything left in run2
+                dest = std::move(cursor2, cursor2 + len2, dest);
+                *dest = std::move(*cursor1);
+            }
+            else if (len1 == 0)
+            {
+                throw std::invalid_argument("Comparison method violates its general contract");
+            }
+            else
+            {
+                std::move(cursor1, cursor1 + len1, dest);
+            }
+        }
+
+        // Merge right to left with run2 in the buffer. Same preconditions as merge_lo.
+        void merge_hi(RandomIter base1, ptrdiff_t len1, RandomIter base2, ptrdiff_t len2)
+        {
+            buffer_iter tmp = buffer.reserve(len2);
+            std::move(base2, base2 + len2, tmp);
+
+            RandomIter cursor1 = base1 + (len1 - 1);
+            buffer_iter cursor2 = tmp + (len2 - 1);
+            RandomIter dest = base2 + (len2 - 1);
+
+            *dest-- = std::move(*cursor1--);
+            if (--len1 == 0)
+            {
+                std::move(tmp, tmp + len2, dest - (len2 - 1));
+                return;
+            }
+            if (len2 == 1)
+            {
+                dest -= len1;
+                cursor1 -= len1;
+                std::move_backward(cursor1 + 1, cursor1 + 1 + len1, dest + 1 + len1);
+                *dest = std::move(*cursor2);
+                return;
+            }
+
+            bool done = false;
+            while (!done)
+            {
+                ptrdiff_t count1 = 0;
+                ptrdiff_t count2 = 0;
+
+                while ((count1 | count2) < min_gallop)
+                {
+                    if (comp(*cursor2, *cursor1))
+                    {
+                        *dest-- = std::move(*cursor1--);
+                        count1++;
+                        count2 = 0;
+                        if (--len1 == 0)
+                            {done = true; break;}
+                    }
+                    else
+                    {
+                        *dest-- = std::move(*cursor2--);
+                        count2++;
+                        count1 = 0;
+                        if (--len2 == 1)
+                            {done = true; break;}
+                    }
+                }
+                if (done)
+                {
+                    break;
+                }
+
+                do
+                {
+                    // Elements of run1 greater than the current run2 element go to the back
+                    count1 = len1 - gallop_right(*cursor2, base1, len1, len1 - 1, comp);
+                    if (count1 != 0)
+                    {
+                        dest -= count1;
+                        cursor1 -= count1;
+                        len1 -= count1;
+                        std::move_backward(cursor1 + 1, cursor1 + 1 + count1, dest + 1 + count1);
+                        if (len1 == 0)
+                            {done = true; break;}
+                    }
+                    *dest-- = std::move(*cursor2--);
+                    if (--len2 == 1)
+                        {done = true; break;}
+
+                    // Elements of run2 greater than or equal to the current run1 element
+                    count2 = len2 - gallop_left(*cursor1, tmp, len2, len2 - 1, comp);
+                    if (count2 != 0)
+                    {
+                        dest -= count2;
+                        cursor2 -= count2;
+                        len2 -= count2;
+                        std::move(cursor2 + 1, cursor2 + 1 + count2, dest + 1);
+                        if (len2 <= 1)
+                            {done = true; break;}
+                    }
+                    *dest-- = std::move(*cursor1--);
+                    if (--len1 == 0)
+                        {done = true; break;}
+
+                    min_gallop--;
+                } while (count1 >= MIN_GALLOP || count2 >= MIN_GALLOP);
+
+                if (done)
+                {
+                    break;
+                }
+
+                if (min_gallop < 0)
+                    {min_gallop = 0;}
+                min_gallop += 2;
+            }
+
+            if (min_gallop < 1)
+                {min_gallop = 1;}
+
+            if (len2 == 1)
+            {
+                // First element of run2 is smaller than everything left in run1
+                dest -= len1;
+                cursor1 -= len1;
+                std::move_backward(cursor1 + 1, cursor1 + 1 + len1, dest + 1 + len1);
+                *dest = std::move(*cursor2);
+            }
+            else if (len2 == 0)
+            {
+                throw std::invalid_argument("Comparison method violates its general contract");
+            }
+            else
+            {
+                std::move(tmp, tmp + len2, dest - (len2 - 1));
+            }
+        }
+    };
+}
+
+// Stable adaptive sort reusing the caller's merge buffer
+template <typename RandomIter, typename Comparator = less_for_iter<RandomIter>>
+void timsort(RandomIter begin, RandomIter end,
+             TimSortBuffer<typename std::iterator_traits<RandomIter>::value_type> & buffer,
+             Comparator comp = Comparator{})
+{
+    using namespace timsort_detail;
+
+    ptrdiff_t remaining = end - begin;
+    if (remaining < 2)
+    {
+        return;
+    }
+
+    // Small ranges never merge, one binary insertion pass over the leading run is enough
+    if (remaining < MIN_MERGE)
+    {
+        ptrdiff_t run = count_run_and_make_ascending(begin, end, comp);
+        binary_insertion(begin, begin + run, end, comp);
+        return;
+    }
+
+    TimSorter<RandomIter, Comparator> sorter(comp, buffer);
+    ptrdiff_t min_run = min_run_length(remaining);
+    RandomIter low = begin;
+
+    while (remaining != 0)
+    {
+        ptrdiff_t run = count_run_and_make_ascending(low, end, comp);
+
+        // Extend short runs to min(min_run, remaining) so merges stay balanced
+        if (run < min_run)
+        {
+            ptrdiff_t forced = std::min(min_run, remaining);
+            binary_insertion(low, low + run, low + forced, comp);
+            run = forced;
+        }
+
+        sorter.push_run(low, run);
+        sorter.merge_collapse();
+
+        low += run;
+        remaining -= run;
+    }
+
+    sorter.merge_force_collapse();
+}
+
+// Stable adaptive sort with a one-off merge buffer
+template <typename RandomIter, typename Comparator = less_for_iter<RandomIter>>
+void timsort(RandomIter begin, RandomIter end, Comparator comp = Comparator{})
+{
+    TimSortBuffer<typename std::iterator_traits<RandomIter>::value_type> buffer;
+    timsort(begin, end, buffer, comp);
+}
+
+#endif
@@ -3,8 +3,11 @@
 
 #include <algorithm>   // std::random_access_iterator_tag
 #include <cstddef>     // size_t
+#include <functional>  // std::less
+#include <iterator>    // std::iterator_traits
 #include <stdexcept>   // std::out_of_range
 #include <type_traits> // std::is_same
+#include <utility>     // std::swap, std::move
 
 template <class T>
 class Vector
@@ -19,13 +22,9 @@ private:
     // You may want to write a function that grows the vector
     void grow()
     {
-        std::cout << "Resize called" << std::endl;
-
         // initialize array with 1 element so that any resize afterward can be double
         if (_capacity == 0)
         {
-            std::cout << "First initialization" << std::endl;
-
             T *largerArray = new T[1];
             _capacity++;
 
@@ -37,15 +36,12 @@ private:
         else
         {
             _capacity = _capacity * 2;
-            std::cout << "New capacity: " << _capacity << std::endl;
             T *largerArray = new T[_capacity];
-            std::cout << "Size: " << _size << std::endl;
 
             // for loop to iterate through new array and copy over
             for (size_t i = 0; i < _size; i++)
             {
                 largerArray[i] = std::move(array[i]);
-                //std::cout << "Position " << i << " Copied" << std::endl;
             }
             delete[] array;
             array = largerArray;
@@ -55,9 +51,6 @@ private:
 public:
     Vector() noexcept
     {
-
-        std::cout << "Default constructor called" << std::endl;
-
         // default 0 to do arithmatic and know that vector had no space
         _size = 0;
         _capacity = 0;
@@ -66,8 +59,6 @@ public:
 
     Vector(size_t count, const T &value)
     {
-        std::cout << "Parameterized constructor (2 args) called" << std::endl;
-
         // Make a vector full of said value
         _size = count;
         array = new T[count];
@@ -81,7 +72,6 @@ public:
 
     explicit Vector(size_t count)
     {
-        std::cout << "Parameterized constructor (1 arg) called" << std::endl;
         _capacity = count;
         _size = count;
 
@@ -91,8 +81,6 @@ public:
 
     Vector(const Vector &other)
     {
-        std::cout << "Copy constructor called" << std::endl;
-
         _size = other._size;
         _capacity = other._capacity;
         array = new T[other._capacity];
@@ -106,8 +94,6 @@ public:
 
     Vector(Vector &&other) noexcept
     {
-        std::cout << "Move constructor called" << std::endl;
-
         _size = other.size();
         _capacity = other.capacity();
 
@@ -120,15 +106,12 @@ public:
 
     ~Vector()
     {
-        std::cout << "Destructor called" << std::endl;
         delete[] array;
         array = nullptr;
     }
 
     Vector &operator=(const Vector &other)
     {
-        std::cout << "= operator called" << std::endl;
-
         //prevent self-copy
         if (this != &other)
         {
@@ -151,8 +134,6 @@ public:
 
     Vector &operator=(Vector &&other) noexcept
     {
-        std::cout << "=&& operator called" << std::endl;
-
         // just MOVE pointer and other attribute, prevent self-assignment error
         if (array != other.array)
         {
@@ -244,8 +225,6 @@ public:
 
     void push_back(const T &value)
     {
-        std::cout << "Push back called" << std::endl;
-
         if (_size >= _capacity)
         {
             grow();
@@ -257,8 +236,6 @@ public:
 
     void push_back(T &&value)
     {
-        std::cout << "Push back && called " << std::endl;
-
         if (_size >= _capacity)
         {
             grow();
@@ -266,7 +243,6 @@ public:
 
         array[_size] = std::move(value);
         _size++;
-        //std::cout << _size << " vs " << _capacity << std::endl;
     }
 
     void pop_back()
@@ -276,7 +252,6 @@ public:
 
     iterator insert(iterator pos, const T &value)
     {
-        std::cout << "Insert copy called" << std::endl;
         size_t position = pos - begin();
         
         if (_size == _capacity)
@@ -299,7 +274,6 @@ public:
     //same as insert copy, but use move on value insead of copying
     iterator insert(iterator pos, T &&value)
     {
-        std::cout << "Insert move called" << std::endl;
         size_t position = pos - begin();
 
         if (_size == _capacity)
@@ -346,8 +320,6 @@ public:
 
     iterator erase(iterator pos)
     {
-        std::cout << "Erase called" << std::endl;
-
         /*using size_t result in segmentation fault due to modifying with move, 
         so use iterator instead..
 
@@ -368,7 +340,6 @@ public:
     //just moving more element than the other one
     iterator erase(iterator first, iterator last)
     {
-        std::cout << "Erase line called" << std::endl;
         int diff = last - first;
         for (iterator i = first; i < end()-diff; i++)
         {
@@ -528,11 +499,9 @@ template <typename _Iterator, bool _enable = is_vector_iterator<_Iterator>::valu
 
 ///////////////////////////////////////////////////////////////////////////////////////
 
-void swap(T & a, T & b) noexcept {
-		T temp = std::move(a);
-		a = std::move(b);
-		b = std::move(temp);
-	}
+// Default comparator for the sorts below, deduced from the iterator's value_type
+template <typename RandomIter>
+using less_for_iter = std::less<typename std::iterator_traits<RandomIter>::value_type>;
 
 	template<typename RandomIter, typename Comparator = less_for_iter<RandomIter>>
 	void bubble(RandomIter begin, RandomIter end, Comparator comp = Comparator{}) {
@@ -552,7 +521,7 @@ void swap(T & a, T & b) noexcept {
 			{
 				if (!comp(*(i-1),*i))
 				{
-					swap(*(i-1),*i);
+					std::swap(*(i-1),*i);
 				}
 			}
 		}
@@ -568,7 +537,7 @@ void swap(T & a, T & b) noexcept {
 			{
 				// Swap now to decrease comparison count
 				RandomIter j = i;
-				swap(*(j-1),*j);
+				std::swap(*(j-1),*j);
 				j--;
 
 				// Unknown how out of place element is, use while
@@ -578,7 +547,7 @@ void swap(T & a, T & b) noexcept {
 					{
 						break;
 					}
-					swap(*(j-1),*j);
+					std::swap(*(j-1),*j);
 					j--;
 				}
 			}
@@ -598,7 +567,7 @@ void swap(T & a, T & b) noexcept {
 			{
 				if (comp(*i,*smaller))
 				{
-					swap(*smaller, *i);
+					std::swap(*smaller, *i);
 				}
 			}
 		}
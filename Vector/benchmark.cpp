@@ -0,0 +1,559 @@
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Vector.h"
+#include "TimSort.h"
+#include "SortingNetwork.h"
+#include "Introsort.h"
+#include "ExternalSort.h"
+#include "SimdSort.h"
+#include "KeySort.h"
+#include "SortedSet.h"
+#include "Search.h"
+#include "StringSort.h"
+
+/*
+    Sorting benchmarks for the Vector sorts.
+
+    Build with optimizations, e.g. g++ -std=c++17 -O2 -march=native benchmark.cpp
+    Run with no arguments for every benchmark, or pass the name of one benchmark.
+*/
+
+using bench_clock = std::chrono::steady_clock;
+
+// Run f once and return the elapsed time in milliseconds
+template <typename Function>
+static double time_ms(Function && f)
+{
+    bench_clock::time_point start = bench_clock::now();
+    f();
+    return std::chrono::duration<double, std::milli>(bench_clock::now() - start).count();
+}
+
+template <typename T>
+static bool is_sorted_vector(Vector<T> & v)
+{
+    return std::is_sorted(v.begin(), v.end());
+}
+
+// Sorted 0..n-1 with a fraction of the positions swapped with random other positions
+static void fill_nearly_sorted(Vector<int> & v, double disorder, std::mt19937 & generator)
+{
+    size_t n = v.size();
+    for (size_t i = 0; i < n; i++)
+    {
+        v[i] = static_cast<int>(i);
+    }
+
+    std::uniform_int_distribution<size_t> position(0, n - 1);
+    size_t swaps = static_cast<size_t>(disorder * n / 2);
+    for (size_t i = 0; i < swaps; i++)
+    {
+        std::swap(v[position(generator)], v[position(generator)]);
+    }
+}
+
+static void bench_timsort()
+{
+    constexpr size_t N = 1 << 16;
+    constexpr double DISORDER[] = {0.0, 0.01, 0.10, 0.50};
+
+    std::mt19937 generator(42);
+    Vector<int> input(N);
+    Vector<int> work(N);
+    TimSortBuffer<int> buffer;
+
+    std::cout << "timsort vs insertion vs std::stable_sort, n = " << N << std::endl;
+    std::cout << std::setw(10) << "disorder" << std::setw(14) << "timsort ms"
+              << std::setw(16) << "insertion ms" << std::setw(18) << "stable_sort ms" << std::endl;
+
+    for (double disorder : DISORDER)
+    {
+        fill_nearly_sorted(input, disorder, generator);
+
+        std::copy(input.begin(), input.end(), work.begin());
+        double tim = time_ms([&] { timsort(work.begin(), work.end(), buffer); });
+        bool ok = is_sorted_vector(work);
+
+        std::copy(input.begin(), input.end(), work.begin());
+        double ins = time_ms([&] { insertion(work.begin(), work.end()); });
+        ok = ok && is_sorted_vector(work);
+
+        std::copy(input.begin(), input.end(), work.begin());
+        double stable = time_ms([&] { std::stable_sort(work.begin(), work.end()); });
+
+        std::cout << std::setw(9) << disorder * 100 << "%" << std::fixed << std::setprecision(3)
+                  << std::setw(14) << tim << std::setw(16) << ins << std::setw(18) << stable
+                  << (ok ? "" : "  NOT SORTED") << std::defaultfloat << std::endl;
+    }
+}
+
+template <size_t N>
+static void bench_network_size(const Vector<int> & input, Vector<int> & work)
+{
+    size_t arrays = input.size() / N;
+
+    std::copy(&input[0], &input[0] + arrays * N, work.begin());
+    double network = time_ms([&] {
+        for (size_t a = 0; a < arrays; a++)
+            {network_sort<N>(work.begin() + a * N);}
+    });
+    bool ok = true;
+    for (size_t a = 0; a < arrays; a++)
+        {ok = ok && std::is_sorted(work.begin() + a * N, work.begin() + (a + 1) * N);}
+
+    std::copy(&input[0], &input[0] + arrays * N, work.begin());
+    double ins = time_ms([&] {
+        for (size_t a = 0; a < arrays; a++)
+            {insertion(work.begin() + a * N, work.begin() + (a + 1) * N);}
+    });
+
+    std::cout << std::setw(4) << N << std::setw(8) << sorting_network_size<N> << std::fixed << std::setprecision(1)
+              << std::setw(14) << network * 1e6 / arrays << std::setw(16) << ins * 1e6 / arrays
+              << (ok ? "" : "  NOT SORTED") << std::defaultfloat << std::endl;
+}
+
+template <size_t... N>
+static void bench_network_sizes(const Vector<int> & input, Vector<int> & work, std::index_sequence<N...>)
+{
+    (bench_network_size<N + 2>(input, work), ...);
+}
+
+static void bench_sorting_networks()
+{
+    constexpr size_t ELEMENTS = 1 << 20;
+
+    std::mt19937 generator(42);
+    Vector<int> input(ELEMENTS);
+    Vector<int> work(ELEMENTS);
+    for (size_t i = 0; i < ELEMENTS; i++)
+        {input[i] = static_cast<int>(generator());}
+
+    std::cout << "network_sort<N> vs insertion on random arrays, ns per array" << std::endl;
+    std::cout << std::setw(4) << "N" << std::setw(8) << "CEs" << std::setw(14) << "network ns"
+              << std::setw(16) << "insertion ns" << std::endl;
+    bench_network_sizes(input, work, std::make_index_sequence<MAX_NETWORK_SIZE - 1>{});
+
+    std::cout << std::endl << "introsort (network base case) vs std::sort, n = " << ELEMENTS << std::endl;
+    std::copy(input.begin(), input.end(), work.begin());
+    double intro = time_ms([&] { introsort(work.begin(), work.end()); });
+    bool ok = is_sorted_vector(work);
+    std::copy(input.begin(), input.end(), work.begin());
+    double std_sort = time_ms([&] { std::sort(work.begin(), work.end()); });
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "  introsort: " << intro << " ms" << (ok ? "" : "  NOT SORTED") << std::endl;
+    std::cout << "  std::sort: " << std_sort << " ms" << std::defaultfloat << std::endl;
+}
+
+static void bench_external_sort()
+{
+    constexpr size_t RECORDS = size_t(16) << 20;    // 128 MB of uint64_t
+
+    namespace fs = std::filesystem;
+    fs::path input = fs::temp_directory_path() / "external_sort_bench.in";
+    fs::path output = fs::temp_directory_path() / "external_sort_bench.out";
+
+    {
+        std::mt19937_64 generator(42);
+        std::ofstream file(input, std::ios::binary);
+        for (size_t i = 0; i < RECORDS; i++)
+        {
+            uint64_t value = generator();
+            file.write(reinterpret_cast<const char *>(&value), sizeof(value));
+        }
+    }
+
+    ExternalSortConfig config;
+    config.memory_budget = size_t(16) << 20;
+    config.block_size = size_t(1) << 20;
+
+    std::cout << "external_sort of " << (RECORDS * sizeof(uint64_t) >> 20) << " MB with a "
+              << (config.memory_budget >> 20) << " MB budget" << std::endl;
+    ExternalSortStats stats = external_sort<uint64_t>(input, output, config);
+
+    bool ok = true;
+    {
+        std::ifstream file(output, std::ios::binary);
+        uint64_t previous = 0, value;
+        size_t count = 0;
+        while (file.read(reinterpret_cast<char *>(&value), sizeof(value)))
+        {
+            ok = ok && previous <= value;
+            previous = value;
+            count++;
+        }
+        ok = ok && count == RECORDS;
+    }
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "  runs: " << stats.runs << ", merge passes: " << stats.merge_passes << std::endl;
+    std::cout << "  run formation: " << stats.run_seconds * 1e3 << " ms, " << stats.run_mb_per_second() << " MB/s" << std::endl;
+    std::cout << "  merge:         " << stats.merge_seconds * 1e3 << " ms, " << stats.merge_mb_per_second() << " MB/s"
+              << (ok ? "" : "  NOT SORTED") << std::defaultfloat << std::endl;
+
+    fs::remove(input);
+    fs::remove(output);
+}
+
+// Average milliseconds per sort of n elements, over enough slices of input to cover it once
+template <typename T, typename Sort>
+static double time_repeated_sort(const Vector<T> & input, Vector<T> & work, size_t n, Sort sort)
+{
+    size_t repeats = std::max<size_t>(1, input.size() / n);
+    double total = 0;
+    for (size_t r = 0; r < repeats; r++)
+    {
+        // Take a different slice each time so small sizes do not sort the same data over and over
+        size_t offset = (r * n) % (input.size() - n + 1);
+        std::copy(&input[0] + offset, &input[0] + offset + n, work.begin());
+        total += time_ms([&] { sort(work.begin(), work.begin() + n); });
+    }
+    return total / repeats;
+}
+
+template <typename T>
+static void bench_simd_sort_type(const char * name)
+{
+    constexpr size_t ELEMENTS = 1 << 20;
+    constexpr size_t SIZES[] = {1000, 10000, 100000, ELEMENTS};
+
+    std::mt19937_64 generator(42);
+    Vector<T> input(ELEMENTS);
+    Vector<T> work(ELEMENTS);
+    for (size_t i = 0; i < ELEMENTS; i++)
+        {input[i] = static_cast<T>(generator());}
+
+    std::cout << name << ", ms per sort" << std::endl;
+    std::cout << std::setw(10) << "n" << std::setw(12) << "introsort" << std::setw(12) << "avx2"
+              << std::setw(12) << "avx512" << std::endl;
+
+    for (size_t n : SIZES)
+    {
+        auto simd = [](SimdLevel level) {
+            return [level](typename Vector<T>::iterator b, typename Vector<T>::iterator e) { simd_sort(b, e, level); };
+        };
+        double intro = time_repeated_sort(input, work, n, [](auto b, auto e) { introsort(b, e); });
+        double avx2 = time_repeated_sort(input, work, n, simd(SimdLevel::AVX2));
+        bool ok = std::is_sorted(work.begin(), work.begin() + n);
+        double avx512 = time_repeated_sort(input, work, n, simd(SimdLevel::AVX512));
+        ok = ok && std::is_sorted(work.begin(), work.begin() + n);
+
+        std::cout << std::setw(10) << n << std::fixed << std::setprecision(3) << std::setw(12) << intro
+                  << std::setw(12) << avx2 << std::setw(12) << avx512 << (ok ? "" : "  NOT SORTED")
+                  << std::defaultfloat << std::endl;
+    }
+}
+
+static void bench_simd_sort()
+{
+    const char * levels[] = {"scalar", "AVX2", "AVX-512"};
+    std::cout << "simd_sort vs introsort, detected: " << levels[static_cast<int>(detected_simd_level())] << std::endl;
+    bench_simd_sort_type<int32_t>("int32_t");
+    bench_simd_sort_type<uint64_t>("uint64_t");
+    bench_simd_sort_type<float>("float");
+}
+
+static void bench_key_sort()
+{
+    constexpr size_t N = 4000;
+
+    // Mixed case, padded words so the projection has real work to do
+    std::mt19937 generator(42);
+    Vector<std::string> input(N);
+    for (size_t i = 0; i < N; i++)
+    {
+        std::string word(std::string(generator() % 4, ' '));
+        size_t length = 4 + generator() % 12;
+        for (size_t c = 0; c < length; c++)
+        {
+            char letter = static_cast<char>('a' + generator() % 26);
+            word += generator() % 2 ? letter : static_cast<char>(std::toupper(letter));
+        }
+        input[i] = word;
+    }
+
+    size_t projections = 0;
+    size_t comparisons = 0;
+
+    // Trim and lowercase, the kind of projection worth caching
+    auto normalize = [&projections](const std::string & word) {
+        projections++;
+        std::string key;
+        for (char c : word)
+        {
+            if (c != ' ')
+                {key += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));}
+        }
+        return key;
+    };
+    auto less_keys = [&comparisons](const std::string & a, const std::string & b) {
+        comparisons++;
+        return a < b;
+    };
+    auto less_elements = [&](const std::string & a, const std::string & b) {
+        return less_keys(normalize(a), normalize(b));
+    };
+
+    Vector<std::string> work(N);
+    std::cout << "Projection sort of " << N << " strings" << std::endl;
+    std::cout << std::setw(28) << "method" << std::setw(14) << "projections" << std::setw(14) << "comparisons"
+              << std::setw(12) << "ms" << std::endl;
+
+    auto report = [&](const char * method, double ms) {
+        std::cout << std::setw(28) << method << std::setw(14) << projections << std::setw(14) << comparisons
+                  << std::fixed << std::setprecision(3) << std::setw(12) << ms << std::defaultfloat << std::endl;
+        projections = 0;
+        comparisons = 0;
+    };
+
+    std::copy(input.begin(), input.end(), work.begin());
+    report("insertion, projecting comp", time_ms([&] { insertion(work.begin(), work.end(), less_elements); }));
+
+    std::copy(input.begin(), input.end(), work.begin());
+    report("timsort, projecting comp", time_ms([&] { timsort(work.begin(), work.end(), less_elements); }));
+
+    std::copy(input.begin(), input.end(), work.begin());
+    report("sort_by_key", time_ms([&] { sort_by_key(work.begin(), work.end(), normalize, less_keys); }));
+    bool ok = std::is_sorted(work.begin(), work.end(), [&](const std::string & a, const std::string & b) {
+        return normalize(a) < normalize(b);
+    });
+    projections = 0;
+
+    std::copy(input.begin(), input.end(), work.begin());
+    report("argsort_by_key (no moves)", time_ms([&] { argsort_by_key(work.begin(), work.end(), normalize, less_keys); }));
+
+    std::cout << (ok ? "" : "  NOT SORTED\n");
+}
+
+// n strictly increasing random ids with gaps, so intersections are partial
+static void fill_sorted_ids(Vector<uint32_t> & ids, std::mt19937 & generator)
+{
+    uint32_t id = 0;
+    for (size_t i = 0; i < ids.size(); i++)
+    {
+        id += 1 + generator() % 4;
+        ids[i] = id;
+    }
+}
+
+static void bench_sorted_sets()
+{
+    constexpr size_t LARGE = 1 << 20;
+    constexpr size_t RATIOS[] = {1, 10, 100, 1000, 10000};
+
+    std::mt19937 generator(42);
+    Vector<uint32_t> large(LARGE);
+    fill_sorted_ids(large, generator);
+    Vector<uint32_t> output(2 * LARGE);
+
+    std::cout << "Sorted set kernels, |A| = " << LARGE << ", us per call" << std::endl;
+    std::cout << std::setw(8) << "ratio" << std::setw(14) << "intersect" << std::setw(14) << "unique+simd"
+              << std::setw(14) << "std::inter" << std::setw(14) << "union" << std::setw(14) << "std::union"
+              << std::setw(14) << "difference" << std::setw(14) << "std::diff" << std::endl;
+
+    for (size_t ratio : RATIOS)
+    {
+        // Small list drawn from the same id space
+        Vector<uint32_t> small(LARGE / ratio);
+        fill_sorted_ids(small, generator);
+        for (size_t i = 0; i < small.size(); i++)
+            {small[i] = static_cast<uint32_t>(small[i] * static_cast<uint64_t>(ratio));}
+
+        auto a0 = large.begin(), a1 = large.end(), b0 = small.begin(), b1 = small.end();
+        auto out = output.begin();
+        size_t repeats = std::min<size_t>(ratio, 100);
+        auto us = [repeats](auto && f) {
+            return time_ms([&] { for (size_t r = 0; r < repeats; r++) f(); }) * 1e3 / repeats;
+        };
+
+        typename Vector<uint32_t>::iterator end_ours, end_std;
+        double inter = us([&] { end_ours = sorted_intersection(a0, a1, b0, b1, out); });
+        double inter_unique = us([&] { sorted_intersection_unique(a0, a1, b0, b1, out); });
+        double std_inter = us([&] { end_std = std::set_intersection(a0, a1, b0, b1, out); });
+        bool ok = end_ours - out == end_std - out;
+        double uni = us([&] { sorted_union(a0, a1, b0, b1, out); });
+        double std_uni = us([&] { std::set_union(a0, a1, b0, b1, out); });
+        double diff = us([&] { sorted_difference(a0, a1, b0, b1, out); });
+        double std_diff = us([&] { std::set_difference(a0, a1, b0, b1, out); });
+
+        std::cout << std::setw(6) << "1:" << ratio << std::fixed << std::setprecision(1)
+                  << std::setw(14) << inter << std::setw(14) << inter_unique << std::setw(14) << std_inter
+                  << std::setw(14) << uni << std::setw(14) << std_uni << std::setw(14) << diff
+                  << std::setw(14) << std_diff << (ok ? "" : "  MISMATCH") << std::defaultfloat << std::endl;
+    }
+}
+
+static void bench_search()
+{
+    struct Size { const char * level; size_t n; };
+    constexpr Size SIZES[] = {{"L1", 1 << 12}, {"L2", 1 << 18}, {"L3", 1 << 22}, {"DRAM", 1 << 27}};
+    constexpr size_t QUERIES = 1 << 20;
+
+    std::mt19937 generator(42);
+    Vector<Vector<uint32_t>::iterator> results(QUERIES);
+
+    std::cout << "Searching sorted uint32 keys spaced ~4 apart, ns per query over " << QUERIES << " queries" << std::endl;
+    std::cout << std::setw(6) << "level" << std::setw(12) << "n" << std::setw(18) << "std::lower_bound"
+              << std::setw(14) << "branchless" << std::setw(10) << "batch" << std::setw(16) << "interpolation" << std::endl;
+
+    for (const Size & size : SIZES)
+    {
+        Vector<uint32_t> keys(size.n);
+        fill_sorted_ids(keys, generator);
+
+        Vector<uint32_t> queries(QUERIES);
+        std::uniform_int_distribution<uint32_t> key(0, keys[size.n - 1] + 1);
+        for (size_t i = 0; i < QUERIES; i++)
+            {queries[i] = key(generator);}
+
+        auto k0 = keys.begin(), k1 = keys.end();
+        auto ns = [](double ms) { return ms * 1e6 / QUERIES; };
+
+        // Sum of offsets keeps every loop from being optimized away and checks they agree
+        size_t sums[4] = {0, 0, 0, 0};
+        double std_ns = ns(time_ms([&] {
+            for (size_t i = 0; i < QUERIES; i++)
+                {sums[0] += std::lower_bound(k0, k1, queries[i]) - k0;}
+        }));
+        double branchless_ns = ns(time_ms([&] {
+            for (size_t i = 0; i < QUERIES; i++)
+                {sums[1] += branchless_lower_bound(k0, k1, queries[i]) - k0;}
+        }));
+        double batch_ns = ns(time_ms([&] {
+            lower_bound_batch(k0, k1, queries.begin(), queries.end(), results.begin());
+        }));
+        for (size_t i = 0; i < QUERIES; i++)
+            {sums[2] += results[i] - k0;}
+        double interpolation_ns = ns(time_ms([&] {
+            for (size_t i = 0; i < QUERIES; i++)
+                {sums[3] += interpolation_search(k0, k1, queries[i]) - k0;}
+        }));
+
+        bool ok = sums[0] == sums[1] && sums[0] == sums[2] && sums[0] == sums[3];
+        std::cout << std::setw(6) << size.level << std::setw(12) << size.n << std::fixed << std::setprecision(1)
+                  << std::setw(18) << std_ns << std::setw(14) << branchless_ns << std::setw(10) << batch_ns
+                  << std::setw(16) << interpolation_ns << (ok ? "" : "  MISMATCH") << std::defaultfloat << std::endl;
+    }
+}
+
+// One word per line, empty when the file does not exist
+static std::vector<std::string> read_words(const std::filesystem::path & path)
+{
+    std::vector<std::string> words;
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line))
+    {
+        if (!line.empty())
+            {words.push_back(line);}
+    }
+    return words;
+}
+
+static void bench_string_sort()
+{
+    constexpr size_t SIZES[] = {1 << 14, 1 << 17, 1 << 20};
+
+    // Same names as Unordered Map/main.cpp, with a built in list when its data files are missing
+    std::filesystem::path data_files = std::filesystem::path("..") / "data_files";
+    std::vector<std::string> adjectives = read_words(data_files / "adjectives.txt");
+    std::vector<std::string> animals = read_words(data_files / "animals.txt");
+    if (adjectives.empty() || animals.empty())
+    {
+        adjectives = {"agile", "ancient", "brave", "bright", "calm", "clever", "curious", "daring", "eager",
+                      "fierce", "fluffy", "gentle", "giant", "graceful", "happy", "humble", "jolly", "loyal",
+                      "mighty", "nimble", "quiet", "rapid", "silent", "sleepy", "spotted", "striped", "swift",
+                      "tiny", "wild", "wise"};
+        animals = {"aardvark", "albatross", "alligator", "alpaca", "antelope", "armadillo", "baboon", "badger",
+                   "barracuda", "beaver", "bison", "buffalo", "camel", "capybara", "caribou", "cheetah",
+                   "chimpanzee", "chinchilla", "cobra", "cougar", "coyote", "crocodile", "dolphin", "eagle",
+                   "elephant", "falcon", "flamingo", "gazelle", "gorilla", "hedgehog", "jaguar", "kangaroo"};
+    }
+
+    std::mt19937 generator(42);
+    std::uniform_int_distribution<size_t> adjective(0, adjectives.size() - 1);
+    std::uniform_int_distribution<size_t> animal(0, animals.size() - 1);
+    std::uniform_int_distribution<int> number(0, 9999);
+
+    std::cout << "Sorting \"Adjective animal N\" names, ns per string" << std::endl;
+    std::cout << std::setw(10) << "n" << std::setw(14) << "string_sort" << std::setw(12) << "std::sort"
+              << std::setw(16) << "views sorted" << std::setw(12) << "std::sort" << std::endl;
+
+    for (size_t n : SIZES)
+    {
+        Vector<std::string> names(n);
+        for (size_t i = 0; i < n; i++)
+        {
+            std::string name = adjectives[adjective(generator)] + " " + animals[animal(generator)] + " " + std::to_string(number(generator));
+            name[0] = static_cast<char>(std::toupper(name[0]));
+            names[i] = name;
+        }
+
+        Vector<std::string> work(n);
+        auto reset = [&] { for (size_t i = 0; i < n; i++) {work[i] = names[i];} };
+
+        reset();
+        double ours = time_ms([&] { string_sort(work.begin(), work.end()); });
+        bool ok = is_sorted_vector(work);
+        reset();
+        double reference = time_ms([&] { std::sort(work.begin(), work.end()); });
+
+        Vector<std::string_view> views(n);
+        for (size_t i = 0; i < n; i++)
+            {views[i] = names[i];}
+        double ours_views = time_ms([&] { string_sort(views.begin(), views.end()); });
+        ok = ok && is_sorted_vector(views);
+        for (size_t i = 0; i < n; i++)
+            {views[i] = names[i];}
+        double reference_views = time_ms([&] { std::sort(views.begin(), views.end()); });
+
+        auto ns = [n](double ms) { return ms * 1e6 / n; };
+        std::cout << std::setw(10) << n << std::fixed << std::setprecision(1) << std::setw(14) << ns(ours)
+                  << std::setw(12) << ns(reference) << std::setw(16) << ns(ours_views) << std::setw(12)
+                  << ns(reference_views) << (ok ? "" : "  NOT SORTED") << std::defaultfloat << std::endl;
+    }
+}
+
+struct Benchmark
+{
+    const char * name;
+    std::function<void()> run;
+};
+
+int main(int argc, char ** argv)
+{
+    const Benchmark benchmarks[] = {
+        {"timsort", bench_timsort},
+        {"networks", bench_sorting_networks},
+        {"external", bench_external_sort},
+        {"simd", bench_simd_sort},
+        {"keysort", bench_key_sort},
+        {"sets", bench_sorted_sets},
+        {"search", bench_search},
+        {"strings", bench_string_sort},
+    };
+
+    for (const Benchmark & benchmark : benchmarks)
+    {
+        if (argc > 1 && std::strcmp(argv[1], benchmark.name) != 0)
+        {
+            continue;
+        }
+        benchmark.run();
+        std::cout << std::endl;
+    }
+
+    return 0;
+}